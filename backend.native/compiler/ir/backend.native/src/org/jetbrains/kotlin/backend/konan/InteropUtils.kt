@@ -73,6 +73,8 @@ internal class InteropBuiltIns(builtIns: KonanBuiltIns) {
 
     val executeImplFunction = concurrentPackageScope.getContributedFunctions("executeImpl").single()
 
+    val executeBatchImplFunction = concurrentPackageScope.getContributedFunctions("executeBatchImpl").single()
+
     private fun KonanBuiltIns.getUnsignedClass(unsignedType: UnsignedType): ClassDescriptor =
             this.builtInsModule.findClassAcrossModuleDependencies(unsignedType.classId)!!
 
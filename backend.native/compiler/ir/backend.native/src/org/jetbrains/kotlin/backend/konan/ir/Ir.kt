@@ -274,6 +274,8 @@ internal class KonanSymbols(context: Context, val symbolTable: SymbolTable, val
 
     val executeImpl = symbolTable.referenceSimpleFunction(context.interopBuiltIns.executeImplFunction)
 
+    val executeBatchImpl = symbolTable.referenceSimpleFunction(context.interopBuiltIns.executeBatchImplFunction)
+
     val areEqualByValue = context.getInternalFunctions("areEqualByValue").map {
         symbolTable.referenceSimpleFunction(it)
     }.associateBy { it.descriptor.valueParameters[0].type.computePrimitiveBinaryTypeOrNull()!! }
@@ -173,12 +173,16 @@ internal class FunctionGenerationContext(val function: LLVMValueRef,
         get() = (irFunction as? IrConstructor)?.constructedClass
     private var returnSlot: LLVMValueRef? = null
     private var slotsPhi: LLVMValueRef? = null
+    // Slots of local variables, placed after all other slots. References from them are not counted.
+    private var stackSlotsPhi: LLVMValueRef? = null
     private val frameOverlaySlotCount =
             (LLVMStoreSizeOfType(llvmTargetData, runtime.frameOverlayType) / runtime.pointerSize).toInt()
     private var slotCount = frameOverlaySlotCount
+    private var stackSlotCount = 0
     private var localAllocs = 0
     private var arenaSlot: LLVMValueRef? = null
     private val slotToVariableLocation = mutableMapOf<Int,VariableDebugLocation>()
+    private val stackSlotToVariableLocation = mutableMapOf<Int,VariableDebugLocation>()
 
     private val prologueBb        = basicBlockInFunction("prologue", startLocation)
     private val localsInitBb      = basicBlockInFunction("locals_init", startLocation)
@@ -213,8 +217,22 @@ internal class FunctionGenerationContext(val function: LLVMValueRef,
         return result
     }
 
-    fun alloca(type: LLVMTypeRef?, name: String = "", variableLocation: VariableDebugLocation? = null): LLVMValueRef {
+    /**
+     * Object reference slots allocated with [onStack] must only be updated with [storeAny] having the same flag.
+     */
+    fun alloca(type: LLVMTypeRef?, name: String = "", variableLocation: VariableDebugLocation? = null,
+               onStack: Boolean = false): LLVMValueRef {
         if (isObjectType(type!!)) {
+            if (onStack) {
+                appendingTo(localsInitBb) {
+                    val slotAddress = gep(stackSlotsPhi!!, Int32(stackSlotCount).llvm, name)
+                    variableLocation?.let {
+                        stackSlotToVariableLocation[stackSlotCount] = it
+                    }
+                    stackSlotCount++
+                    return slotAddress
+                }
+            }
             appendingTo(localsInitBb) {
                 val slotAddress = gep(slotsPhi!!, Int32(slotCount).llvm, name)
                 variableLocation?.let {
@@ -268,8 +286,8 @@ internal class FunctionGenerationContext(val function: LLVMValueRef,
     fun loadSlot(address: LLVMValueRef, isVar: Boolean, name: String = ""): LLVMValueRef {
         val value = LLVMBuildLoad(builder, address, name)!!
         if (isObjectRef(value) && isVar) {
-            val slot = alloca(LLVMTypeOf(value), variableLocation = null)
-            storeAny(value, slot)
+            val slot = alloca(LLVMTypeOf(value), variableLocation = null, onStack = true)
+            storeAny(value, slot, onStack = true)
         }
         return value
     }
@@ -280,9 +298,12 @@ internal class FunctionGenerationContext(val function: LLVMValueRef,
         LLVMBuildStore(builder, value, ptr)
     }
 
-    fun storeAny(value: LLVMValueRef, ptr: LLVMValueRef) {
+    fun storeAny(value: LLVMValueRef, ptr: LLVMValueRef, onStack: Boolean = false) {
         if (isObjectRef(value)) {
-            updateRef(value, ptr)
+            if (onStack)
+                updateStackRef(value, ptr)
+            else
+                updateRef(value, ptr)
         } else {
             LLVMBuildStore(builder, value, ptr)
         }
@@ -305,6 +326,10 @@ internal class FunctionGenerationContext(val function: LLVMValueRef,
         call(context.llvm.updateRefFunction, listOf(address, value))
     }
 
+    private fun updateStackRef(value: LLVMValueRef, address: LLVMValueRef) {
+        call(context.llvm.updateStackRefFunction, listOf(address, value))
+    }
+
     //-------------------------------------------------------------------------//
 
     fun call(llvmFunction: LLVMValueRef, args: List<LLVMValueRef>,
@@ -826,6 +851,7 @@ internal class FunctionGenerationContext(val function: LLVMValueRef,
         }
         positionAtEnd(localsInitBb)
         slotsPhi = phi(kObjHeaderPtrPtr)
+        stackSlotsPhi = phi(kObjHeaderPtrPtr)
         // Is removed by DCE trivially, if not needed.
         arenaSlot = intToPtr(
                 or(ptrToInt(slotsPhi, codegen.intPtrType), codegen.immOneIntPtrType), kObjHeaderPtrPtr)
@@ -835,7 +861,7 @@ internal class FunctionGenerationContext(val function: LLVMValueRef,
     internal fun epilogue() {
         appendingTo(prologueBb) {
             val slots = if (needSlots)
-                LLVMBuildArrayAlloca(builder, kObjHeaderPtr, Int32(slotCount).llvm, "")!!
+                LLVMBuildArrayAlloca(builder, kObjHeaderPtr, Int32(slotCount + stackSlotCount).llvm, "")!!
             else
                 kNullObjHeaderPtrPtr
             if (needSlots) {
@@ -843,12 +869,18 @@ internal class FunctionGenerationContext(val function: LLVMValueRef,
                 val slotsMem = bitcast(kInt8Ptr, slots)
                 call(context.llvm.memsetFunction,
                         listOf(slotsMem, Int8(0).llvm,
-                                Int32(slotCount * codegen.runtime.pointerSize).llvm,
+                                Int32((slotCount + stackSlotCount) * codegen.runtime.pointerSize).llvm,
                                 Int32(codegen.runtime.pointerAlignment).llvm,
                                 Int1(0).llvm))
-                call(context.llvm.enterFrameFunction, listOf(slots, Int32(vars.skip).llvm, Int32(slotCount).llvm))
+                call(context.llvm.enterFrameFunction,
+                        listOf(slots, Int32(vars.skip).llvm, Int32(slotCount).llvm, Int32(stackSlotCount).llvm))
             }
             addPhiIncoming(slotsPhi!!, prologueBb to slots)
+            val stackSlots = if (needSlots) gep(slots, Int32(slotCount).llvm) else kNullObjHeaderPtrPtr
+            addPhiIncoming(stackSlotsPhi!!, prologueBb to stackSlots)
+            stackSlotToVariableLocation.forEach { slot, variable ->
+                slotToVariableLocation[slotCount + slot] = variable
+            }
             memScoped {
                 slotToVariableLocation.forEach { slot, variable ->
                     val expr = longArrayOf(DwarfOp.DW_OP_plus_uconst.value,
@@ -937,6 +969,7 @@ internal class FunctionGenerationContext(val function: LLVMValueRef,
         vars.clear()
         returnSlot = null
         slotsPhi = null
+        stackSlotsPhi = null
     }
 
     //-------------------------------------------------------------------------//
@@ -1033,13 +1066,13 @@ internal class FunctionGenerationContext(val function: LLVMValueRef,
 
     private val needSlots: Boolean
         get() {
-            return slotCount > frameOverlaySlotCount || localAllocs > 0
+            return slotCount > frameOverlaySlotCount || stackSlotCount > 0 || localAllocs > 0
         }
 
     private fun releaseVars() {
         if (needSlots) {
             call(context.llvm.leaveFrameFunction,
-                    listOf(slotsPhi!!, Int32(vars.skip).llvm, Int32(slotCount).llvm))
+                    listOf(slotsPhi!!, Int32(vars.skip).llvm, Int32(slotCount).llvm, Int32(stackSlotCount).llvm))
         }
     }
 }
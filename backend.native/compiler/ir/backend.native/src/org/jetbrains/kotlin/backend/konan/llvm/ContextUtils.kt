@@ -384,6 +384,7 @@ internal class Llvm(val context: Context, val llvmModule: LLVMModuleRef) {
     val initSharedInstanceFunction = importRtFunction("InitSharedInstance")
     val updateReturnRefFunction = importRtFunction("UpdateReturnRef")
     val updateRefFunction = importRtFunction("UpdateRef")
+    val updateStackRefFunction = importRtFunction("UpdateStackRef")
     val enterFrameFunction = importRtFunction("EnterFrame")
     val leaveFrameFunction = importRtFunction("LeaveFrame")
     val getReturnSlotIfArenaFunction = importRtFunction("GetReturnSlotIfArena")
@@ -22,9 +22,10 @@ internal class VariableManager(val functionGenerationContext: FunctionGeneration
         fun address() : LLVMValueRef
     }
 
-    inner class SlotRecord(val address: LLVMValueRef, val refSlot: Boolean, val isVar: Boolean) : Record {
+    inner class SlotRecord(val address: LLVMValueRef, val refSlot: Boolean, val isVar: Boolean,
+                           val onStack: Boolean = false) : Record {
         override fun load() : LLVMValueRef = functionGenerationContext.loadSlot(address, isVar)
-        override fun store(value: LLVMValueRef) = functionGenerationContext.storeAny(value, address)
+        override fun store(value: LLVMValueRef) = functionGenerationContext.storeAny(value, address, onStack)
         override fun address() : LLVMValueRef = this.address
         override fun toString() = (if (refSlot) "refslot" else "slot") + " for ${address}"
     }
@@ -70,10 +71,11 @@ internal class VariableManager(val functionGenerationContext: FunctionGeneration
         assert(!contextVariablesToIndex.contains(valueDeclaration))
         val index = variables.size
         val type = functionGenerationContext.getLLVMType(valueDeclaration.type)
-        val slot = functionGenerationContext.alloca(type, valueDeclaration.name.asString(), variableLocation)
+        // Local variables are only accessed from this function, so references from them are not counted.
+        val slot = functionGenerationContext.alloca(type, valueDeclaration.name.asString(), variableLocation, onStack = true)
         if (value != null)
-            functionGenerationContext.storeAny(value, slot)
-        variables.add(SlotRecord(slot, functionGenerationContext.isObjectType(type), isVar))
+            functionGenerationContext.storeAny(value, slot, onStack = true)
+        variables.add(SlotRecord(slot, functionGenerationContext.isObjectType(type), isVar, onStack = true))
         contextVariablesToIndex[valueDeclaration] = index
         return index
     }
@@ -60,10 +60,12 @@ internal class WorkersBridgesBuilding(val context: Context) : DeclarationContain
                 expression.transformChildrenVoid(this)
 
                 val descriptor = expression.descriptor.original
-                if (descriptor != interop.executeImplFunction)
+                if (descriptor != interop.executeImplFunction && descriptor != interop.executeBatchImplFunction)
                     return expression
 
-                val job = expression.getValueArgument(3) as IrFunctionReference
+                // Job is the last argument of both.
+                val jobIndex = expression.valueArgumentsCount - 1
+                val job = expression.getValueArgument(jobIndex) as IrFunctionReference
                 val jobFunction = (job.symbol as IrSimpleFunctionSymbol).owner
 
                 if (!::runtimeJobFunction.isInitialized) {
@@ -111,7 +113,7 @@ internal class WorkersBridgesBuilding(val context: Context) : DeclarationContain
                         overriddenFunction = overriddenJobDescriptor,
                         targetSymbol = job.symbol)
                 bridges += bridge
-                expression.putValueArgument(3, IrFunctionReferenceImpl(
+                expression.putValueArgument(jobIndex, IrFunctionReferenceImpl(
                         startOffset   = job.startOffset,
                         endOffset     = job.endOffset,
                         type          = job.type,
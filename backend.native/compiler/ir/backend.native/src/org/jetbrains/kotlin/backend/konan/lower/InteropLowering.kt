@@ -985,8 +985,14 @@ private class InteropTransformer(val context: Context, val irFile: IrFile) : IrB
                     }
                     expression
                 }
-                IntrinsicType.WORKER_EXECUTE -> {
-                    val irCallableReference = unwrapStaticFunctionArgument(expression.getValueArgument(2)!!)
+                IntrinsicType.WORKER_EXECUTE, IntrinsicType.WORKER_EXECUTE_BATCH -> {
+                    // Job is the last argument, the rest of arguments are passed to the implementation as is.
+                    val jobIndex = expression.valueArgumentsCount - 1
+                    val executeImpl = if (intrinsicType == IntrinsicType.WORKER_EXECUTE)
+                        symbols.executeImpl
+                    else
+                        symbols.executeBatchImpl
+                    val irCallableReference = unwrapStaticFunctionArgument(expression.getValueArgument(jobIndex)!!)
 
                     if (irCallableReference == null || irCallableReference.getArguments().isNotEmpty()) {
                         context.reportCompilationError(
@@ -999,15 +1005,19 @@ private class InteropTransformer(val context: Context, val irFile: IrFile) : IrB
                     val target = targetSymbol.descriptor
                     val jobPointer = IrFunctionReferenceImpl(
                             builder.startOffset, builder.endOffset,
-                            symbols.executeImpl.owner.valueParameters[3].type,
+                            executeImpl.owner.valueParameters[jobIndex + 1].type,
                             targetSymbol, target,
                             typeArgumentsCount = 0)
 
-                    builder.irCall(symbols.executeImpl).apply {
-                        putValueArgument(0, expression.dispatchReceiver)
-                        putValueArgument(1, expression.getValueArgument(0))
-                        putValueArgument(2, expression.getValueArgument(1))
-                        putValueArgument(3, jobPointer)
+                    // Receiver is either a worker or a worker pool, both are scheduled to by id.
+                    val receiver = expression.dispatchReceiver!!
+                    val idGetter = (receiver.type.classifierOrFail as IrClassSymbol).getPropertyGetter("id")!!
+
+                    builder.irCall(executeImpl).apply {
+                        putValueArgument(0, builder.irCall(idGetter).apply { dispatchReceiver = receiver })
+                        for (index in 0 until jobIndex)
+                            putValueArgument(index + 1, expression.getValueArgument(index))
+                        putValueArgument(jobIndex + 1, jobPointer)
                     }
                 }
                 else -> expression
@@ -339,6 +339,24 @@ internal class ModuleDFGBuilder(val context: Context, val irModule: IrModuleFrag
                 expressions += jobInvocation
             }
 
+            if (expression is IrCall && expression.symbol == executeBatchImplSymbol) {
+                // Same as executeImpl, but producer is called with index of each job in the batch.
+                val producerInvocation = IrCallImpl(expression.startOffset, expression.endOffset,
+                        executeBatchImplProducerInvoke.returnType,
+                        executeBatchImplProducerInvoke.symbol)
+                producerInvocation.dispatchReceiver = expression.getValueArgument(3)
+                producerInvocation.putValueArgument(0, IrConstImpl.int(expression.startOffset, expression.endOffset,
+                        context.irBuiltIns.intType, 0))
+                val jobFunctionReference = expression.getValueArgument(4) as? IrFunctionReference
+                        ?: error("A function reference expected")
+                val jobInvocation = IrCallImpl(expression.startOffset, expression.endOffset,
+                        jobFunctionReference.symbol.owner.returnType,
+                        jobFunctionReference.symbol)
+                jobInvocation.putValueArgument(0, producerInvocation)
+
+                expressions += jobInvocation
+            }
+
             if (expression is IrReturnableBlock) {
                 returnableBlockValues.put(expression, mutableListOf())
             }
@@ -408,6 +426,10 @@ internal class ModuleDFGBuilder(val context: Context, val irModule: IrModuleFrag
     private val executeImplProducerClassSymbol = symbols.functions[0]
     private val executeImplProducerInvoke = executeImplProducerClassSymbol.owner.simpleFunctions()
             .single { it.name == OperatorNameConventions.INVOKE }
+    private val executeBatchImplSymbol = symbols.executeBatchImpl
+    private val executeBatchImplProducerClassSymbol = symbols.functions[1]
+    private val executeBatchImplProducerInvoke = executeBatchImplProducerClassSymbol.owner.simpleFunctions()
+            .single { it.name == OperatorNameConventions.INVOKE }
 
     private inner class FunctionDFGBuilder(val expressionValuesExtractor: ExpressionValuesExtractor,
                                            val variableValues: VariableValues,
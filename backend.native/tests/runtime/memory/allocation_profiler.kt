@@ -0,0 +1,33 @@
+/*
+ * Copyright 2010-2018 JetBrains s.r.o. Use of this source code is governed by the Apache 2.0 license
+ * that can be found in the LICENSE file.
+ */
+
+package runtime.memory.allocation_profiler
+
+import kotlin.test.*
+import kotlin.native.internal.AllocationProfiler
+
+class Data(val value: Int)
+
+@Test fun runTest() {
+    assertEquals(0L, AllocationProfiler.samplingInterval)
+
+    AllocationProfiler.samplingInterval = 1024
+    assertEquals(1024L, AllocationProfiler.samplingInterval)
+    var sum = 0
+    for (i in 0 until 10000) {
+        sum += Data(i).value
+    }
+    AllocationProfiler.samplingInterval = 0
+    assertEquals(49995000, sum)
+
+    val profile = AllocationProfiler.dump()
+    assertTrue(profile.size > 0)
+    // Type names are kept in the profile string table.
+    val text = profile.map { it.toChar() }.joinToString("")
+    assertTrue(text.contains("runtime.memory.allocation_profiler.Data"))
+
+    AllocationProfiler.reset()
+    println("OK")
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright 2010-2018 JetBrains s.r.o. Use of this source code is governed by the Apache 2.0 license
+ * that can be found in the LICENSE file.
+ */
+
+package runtime.memory.gc_policy
+
+import kotlin.test.*
+import kotlin.native.internal.GC
+import kotlin.native.ref.*
+
+class Node(var next: Node?)
+
+private fun createLoop(): WeakReference<Node> {
+    val node1 = Node(null)
+    val node2 = Node(node1)
+    node1.next = node2
+    return WeakReference(node1)
+}
+
+@Test fun runTest() {
+    assertTrue(GC.autotune)
+    GC.autotune = false
+    assertFalse(GC.autotune)
+
+    assertEquals(0L, GC.targetPauseMicros)
+    GC.targetPauseMicros = 100
+    assertEquals(100L, GC.targetPauseMicros)
+
+    assertEquals(0L, GC.allocationThreshold)
+    GC.allocationThreshold = 1024
+    assertEquals(1024L, GC.allocationThreshold)
+
+    // Few candidates, but enough allocations to trigger collection.
+    val threshold = GC.threshold
+    val ref = createLoop()
+    repeat(1000) { Any() }
+    createLoop()
+    assertNull(ref.get())
+    assertEquals(threshold, GC.threshold)
+
+    GC.allocationThreshold = 0
+    GC.targetPauseMicros = 0
+    GC.autotune = true
+    println("OK")
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2010-2018 JetBrains s.r.o. Use of this source code is governed by the Apache 2.0 license
+ * that can be found in the LICENSE file.
+ */
+
+package runtime.memory.heap_snapshot
+
+import kotlin.test.*
+import kotlin.native.internal.HeapSnapshot
+
+class Node(val next: Node?)
+
+class Released(val value: Int)
+
+// Every object is referenced twice, so releasing the first reference makes it a cycle candidate.
+fun makeReleased(): Array<Array<Released?>> {
+    val first = arrayOfNulls<Released>(1000)
+    val second = arrayOfNulls<Released>(1000)
+    for (i in 0 until 1000) {
+        first[i] = Released(i)
+        second[i] = first[i]
+    }
+    return arrayOf(first, second)
+}
+
+fun release(arrays: Array<Array<Released?>>) {
+    for (array in arrays) {
+        for (i in array.indices) array[i] = null
+    }
+}
+
+fun text(snapshot: ByteArray) = snapshot.map { it.toChar() }.joinToString("")
+
+@Test fun runTest() {
+    val empty = HeapSnapshot.dump()
+    assertEquals("KNHS", text(empty.copyOfRange(0, 4)))
+
+    var list: Node? = null
+    for (i in 0 until 1000) {
+        list = Node(list)
+    }
+    val snapshot = HeapSnapshot.dump()
+    // Every node is recorded along with its reference to the next one.
+    assertTrue(snapshot.size > empty.size + 1000 * 8)
+    val content = text(snapshot)
+    assertTrue(content.contains("runtime.memory.heap_snapshot.Node"))
+    assertNotNull(list)
+
+    // Objects released right before the dump are not reported.
+    val arrays = makeReleased()
+    assertTrue(text(HeapSnapshot.dump()).contains("runtime.memory.heap_snapshot.Released"))
+    release(arrays)
+    assertFalse(text(HeapSnapshot.dump()).contains("runtime.memory.heap_snapshot.Released"))
+    println("OK")
+}
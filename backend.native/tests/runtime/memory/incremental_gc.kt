@@ -0,0 +1,33 @@
+/*
+ * Copyright 2010-2018 JetBrains s.r.o. Use of this source code is governed by the Apache 2.0 license
+ * that can be found in the LICENSE file.
+ */
+
+package runtime.memory.incremental_gc
+
+import kotlin.test.*
+import kotlin.native.internal.GC
+import kotlin.native.ref.*
+
+class Node(var next: Node?)
+
+private fun createLoop(): WeakReference<Node> {
+    val node1 = Node(null)
+    val node2 = Node(node1)
+    node1.next = node2
+    return WeakReference(node1)
+}
+
+@Test fun runTest() {
+    assertEquals(0L, GC.maxPauseMicros)
+    GC.maxPauseMicros = 1
+    assertEquals(1L, GC.maxPauseMicros)
+
+    // Enough cycle candidates to trigger several bounded collections.
+    val refs = Array(GC.threshold * 4) { createLoop() }
+    GC.collect()
+    refs.forEach { assertNull(it.get()) }
+
+    GC.maxPauseMicros = 0
+    println("OK")
+}
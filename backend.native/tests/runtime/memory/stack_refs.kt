@@ -0,0 +1,35 @@
+/*
+ * Copyright 2010-2018 JetBrains s.r.o. Use of this source code is governed by the Apache 2.0 license
+ * that can be found in the LICENSE file.
+ */
+
+package runtime.memory.stack_refs
+
+import kotlin.test.*
+import kotlin.native.internal.GC
+import kotlin.native.ref.*
+
+class Node(var next: Node?)
+
+// Allocated in the callee, so that the caller refers to the object from its local variable only.
+fun makeNode() = Node(null)
+
+@Test fun runTest() {
+    // Only referenced from an uncounted local variable slot.
+    var node: Node? = makeNode()
+    val ref = WeakReference(node!!)
+    GC.collect()
+    assertNotNull(ref.get())
+
+    // Enough garbage to overflow zero count table while local still holds the object.
+    for (i in 0 until 10000) {
+        node!!.next = Node(null)
+    }
+    GC.collect()
+    assertNotNull(ref.get())
+
+    node = null
+    GC.collect()
+    assertNull(ref.get())
+    println("OK")
+}
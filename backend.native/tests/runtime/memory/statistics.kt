@@ -0,0 +1,28 @@
+/*
+ * Copyright 2010-2018 JetBrains s.r.o. Use of this source code is governed by the Apache 2.0 license
+ * that can be found in the LICENSE file.
+ */
+
+package runtime.memory.statistics
+
+import kotlin.test.*
+import kotlin.native.internal.GC
+
+class Node(var next: Node?)
+
+@Test fun runTest() {
+    val before = GC.statistics()
+    val nodes = Array(100) { Node(null) }
+    nodes.forEachIndexed { index, node -> node.next = nodes[(index + 1) % nodes.size] }
+    GC.collect()
+    val after = GC.statistics()
+
+    assertTrue(after.allocatedContainers >= before.allocatedContainers + 100)
+    assertTrue(after.allocatedBytes > before.allocatedBytes)
+    assertTrue(after.addRefs > before.addRefs)
+    assertEquals(before.gcRuns + 1, after.gcRuns)
+    assertTrue(after.gcMaxPauseMicros <= after.gcPauseMicros)
+    assertEquals(after.allocatedContainers, after.allocations.sum())
+    assertTrue(after.toJson().startsWith("{\"allocatedBytes\":"))
+    println("OK")
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2010-2018 JetBrains s.r.o. Use of this source code is governed by the Apache 2.0 license
+ * that can be found in the LICENSE file.
+ */
+
+package runtime.workers.atomic_stress
+
+import kotlin.test.*
+
+import kotlin.native.concurrent.*
+import kotlin.native.internal.GC
+import kotlin.native.internal.HeapSnapshot
+
+// Fields are set from the same number, so that reading a freed or overwritten value is noticed.
+class Value(val first: Int, val second: Int)
+
+const val VALUE_COUNT = 100
+const val ITERATIONS = 10000
+
+fun isValid(value: Value?) = value == null || (value.first in 0 until VALUE_COUNT && value.second == -value.first)
+
+fun text(snapshot: ByteArray) = snapshot.map { it.toChar() }.joinToString("")
+
+fun stress(readers: Array<Worker>, writers: Array<Worker>) {
+    val values = Array(VALUE_COUNT) { Value(it, -it) }.freeze()
+    val reference = AtomicReference<Value?>(values[0])
+    val readerFutures = readers.map { worker ->
+        worker.execute(TransferMode.SAFE, { reference }) { reference ->
+            var valid = true
+            for (i in 0 until ITERATIONS) {
+                if (!isValid(reference.value)) valid = false
+            }
+            valid
+        }
+    }
+    val writerFutures = writers.mapIndexed { index, worker ->
+        worker.execute(TransferMode.SAFE, { Triple(reference, values, index) }) { (reference, values, index) ->
+            var valid = true
+            for (i in 0 until ITERATIONS) {
+                val next = values[(i * (index + 1)) % values.size]
+                if (i % 2 == 0) {
+                    reference.value = next
+                } else {
+                    val current = reference.value
+                    if (!isValid(current)) valid = false
+                    reference.compareAndSet(current, next)
+                }
+            }
+            valid
+        }
+    }
+    (readerFutures + writerFutures).forEach {
+        assertTrue(it.result)
+    }
+    assertTrue(isValid(reference.value))
+    reference.value = null
+}
+
+@Test fun runTest() {
+    val readers = Array(4) { Worker.start() }
+    val writers = Array(4) { Worker.start() }
+    stress(readers, writers)
+
+    // Values retired by the writers are released once no longer read.
+    (readers + writers).map { worker ->
+        worker.execute(TransferMode.SAFE, {}) { GC.collect() }
+    }.forEach {
+        it.result
+    }
+    GC.collect()
+    assertFalse(text(HeapSnapshot.dump()).contains("runtime.workers.atomic_stress.Value"))
+
+    (readers + writers).forEach {
+        it.requestTermination().result
+    }
+    println("OK")
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2010-2018 JetBrains s.r.o. Use of this source code is governed by the Apache 2.0 license
+ * that can be found in the LICENSE file.
+ */
+
+package runtime.workers.freeze7
+
+import kotlin.test.*
+import kotlin.native.concurrent.*
+
+class Point(val x: Int, val y: Int, val name: String)
+
+class Node(val value: Int) {
+    var next: Node? = null
+    val children = mutableListOf<Node>()
+}
+
+data class Config(val values: Map<String, List<Int>>, val root: Node)
+
+fun buildConfig(version: Int): Config {
+    val root = Node(0)
+    for (index in 1..10) {
+        val child = Node(index)
+        child.next = root
+        root.children += child
+    }
+    return Config((0 until 100).associate { "key $it" to List(10) { index -> index + version } }, root)
+}
+
+@Test fun runTest() {
+    // Acyclic types.
+    val point = Point(1, 2, "point").freeze()
+    assertTrue(point.isFrozen)
+    assertTrue(point.name.isFrozen)
+    val blocker = Point(3, 4, "blocker")
+    blocker.ensureNeverFrozen()
+    assertFailsWith<FreezingException> { blocker.freeze() }
+    assertFalse(blocker.isFrozen)
+
+    // Graph built frozen, with cycles.
+    for (version in 0 until 10) {
+        val config = buildFrozen { buildConfig(version) }
+        assertTrue(config.isFrozen)
+        assertTrue(config.values.isFrozen)
+        assertTrue(config.root.children[5].next!!.isFrozen)
+        assertEquals(version + 9, config.values["key 99"]!![9])
+        assertSame(config.root, config.root.children[5].next)
+        assertFailsWith<InvalidMutabilityException> { config.root.next = null }
+    }
+
+    // Objects allocated outside are frozen too.
+    val outside = Node(42)
+    val holder = buildFrozen { listOf(outside) }
+    assertTrue(outside.isFrozen)
+    assertSame(outside, holder[0])
+
+    val neverFrozen = Node(43)
+    neverFrozen.ensureNeverFrozen()
+    assertFailsWith<FreezingException> { buildFrozen { listOf(Node(1), neverFrozen) } }
+    assertFalse(neverFrozen.isFrozen)
+
+    println("OK")
+}
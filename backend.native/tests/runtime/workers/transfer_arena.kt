@@ -0,0 +1,118 @@
+/*
+ * Copyright 2010-2018 JetBrains s.r.o. Use of this source code is governed by the Apache 2.0 license
+ * that can be found in the LICENSE file.
+ */
+
+package runtime.workers.transfer_arena
+
+import kotlin.test.*
+
+import kotlin.native.concurrent.*
+import kotlin.native.internal.HeapSnapshot
+
+class Node(val value: Int, var next: Node?)
+
+data class Message(val id: Int, val fields: Map<String, List<Int>>)
+
+fun parse(id: Int) = Message(id, (0 until 10).associate { "field $it" to List(it) { index -> index + id } })
+
+class Holder(var node: Node?)
+
+fun makeHolder() = Holder(Node(1, null))
+
+fun sum(message: Message) = message.fields.values.sumBy { it.sum() }
+
+class InArena(val value: Int)
+
+class Adopted(val value: Int)
+
+class BuiltFrozen(val value: Int)
+
+fun text(snapshot: ByteArray) = snapshot.map { it.toChar() }.joinToString("")
+
+@Test fun runTest() {
+    val worker = Worker.start()
+    val futures = (0 until 100).map { id ->
+        worker.execute(TransferMode.ARENA, { parse(id) }) { message ->
+            // Result of the job is checked as in safe mode.
+            parse(sum(message))
+        }
+    }
+    futures.forEachIndexed { id, future ->
+        assertEquals(sum(parse(sum(parse(id)))), sum(future.result))
+    }
+
+    // Cyclic graph.
+    val cycle = worker.execute(TransferMode.ARENA, {
+        val head = Node(0, null)
+        var node = head
+        for (value in 1 until 100) {
+            node.next = Node(value, null)
+            node = node.next!!
+        }
+        node.next = head
+        head
+    }) { head ->
+        var node = head.next!!
+        var count = 1
+        while (node !== head) {
+            count++
+            node = node.next!!
+        }
+        count
+    }
+    assertEquals(100, cycle.result)
+
+    // Objects allocated outside of the arena are checked as in safe mode.
+    val holder = makeHolder()
+    val detached = DetachedObjectGraph(TransferMode.ARENA) {
+        val node = Node(0, holder.node)
+        holder.node = null
+        node
+    }
+    assertEquals(1, detached.attach().next!!.value)
+
+    // Shared objects are rejected, either allocated in the arena or not.
+    val shared = Node(2, null)
+    assertFailsWith<IllegalStateException> {
+        worker.execute(TransferMode.ARENA, { Node(0, shared) }) { it }
+    }
+    var leaked: Node? = null
+    assertFailsWith<IllegalStateException> {
+        worker.execute(TransferMode.ARENA, {
+            val node = Node(3, null)
+            leaked = Node(4, node)
+            node
+        }) { it }
+    }
+    assertEquals(3, leaked!!.next!!.value)
+
+    // Frozen objects are shared.
+    val frozen = Node(5, null).freeze()
+    assertEquals(5, worker.execute(TransferMode.ARENA, { Node(0, frozen) }) { it.next!!.value }.result)
+
+    // Objects allocated in the open transfer arena are reported by the heap snapshot.
+    val inArena = DetachedObjectGraph(TransferMode.ARENA) {
+        val marker = InArena(42)
+        val dump = HeapSnapshot.dump()
+        assertEquals(42, marker.value)
+        dump
+    }.attach()
+    assertTrue(text(inArena).contains("runtime.workers.transfer_arena.InArena"))
+
+    // Objects of closed arenas are reported by the thread they were transferred to.
+    val adopted = worker.execute(TransferMode.ARENA, { Adopted(7) }) { adopted ->
+        val dump = HeapSnapshot.dump()
+        assertEquals(7, adopted.value)
+        dump
+    }.result
+    assertTrue(text(adopted).contains("runtime.workers.transfer_arena.Adopted"))
+
+    // And so are frozen objects built in an arena.
+    val builtFrozen = buildFrozen { BuiltFrozen(8) }
+    assertTrue(text(HeapSnapshot.dump()).contains("runtime.workers.transfer_arena.BuiltFrozen"))
+    assertEquals(8, builtFrozen.value)
+
+    worker.requestTermination().result
+    println("OK")
+}
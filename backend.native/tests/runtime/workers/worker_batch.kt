@@ -0,0 +1,52 @@
+/*
+ * Copyright 2010-2018 JetBrains s.r.o. Use of this source code is governed by the Apache 2.0 license
+ * that can be found in the LICENSE file.
+ */
+
+package runtime.workers.worker_batch
+
+import kotlin.test.*
+
+import kotlin.native.concurrent.*
+
+data class BatchArgument(val index: Int, val name: String)
+
+@Test fun runTest() {
+    val worker = Worker.start()
+    val group = worker.executeBatch(TransferMode.SAFE, 1000, { index -> BatchArgument(index, "job $index") }) { input ->
+        input.name.length + input.index
+    }
+    val results = group.results
+    assertEquals(1000, results.size)
+    results.forEachIndexed { index, result ->
+        assertEquals("job $index".length + index, result)
+    }
+
+    // Any throwing job fails the whole batch.
+    val failed = worker.executeBatch(TransferMode.SAFE, 10, { it }) { input ->
+        if (input == 5) throw Error("Job failed")
+        input
+    }
+    assertFailsWith<IllegalStateException> {
+        failed.results
+    }
+    assertEquals(0, worker.executeBatch(TransferMode.SAFE, 0, { it }) { it }.results.size)
+
+    // All produced objects together must be isolated.
+    val shared = BatchArgument(0, "shared")
+    assertFailsWith<IllegalStateException> {
+        worker.executeBatch(TransferMode.SAFE, 2, { shared }) { it }
+    }
+
+    val pool = WorkerPool.start(2)
+    val groups = Array(4) { batch ->
+        pool.executeBatch(TransferMode.SAFE, 100, { index -> batch * 100 + index }) { it * 2 }
+    }
+    groups.forEachIndexed { batch, poolGroup ->
+        assertEquals(List(100) { index -> (batch * 100 + index) * 2 }, poolGroup.results)
+    }
+
+    pool.requestTermination().result
+    worker.requestTermination().result
+    println("OK")
+}
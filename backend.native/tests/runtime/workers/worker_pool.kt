@@ -0,0 +1,45 @@
+/*
+ * Copyright 2010-2018 JetBrains s.r.o. Use of this source code is governed by the Apache 2.0 license
+ * that can be found in the LICENSE file.
+ */
+
+package runtime.workers.worker_pool
+
+import kotlin.test.*
+
+import kotlin.native.concurrent.*
+
+data class PoolArgument(val index: Int, val work: Int)
+
+@Test fun runTest() {
+    val pool = WorkerPool.start(4)
+    // Uneven jobs: every tenth one is much longer than the others.
+    val futures = Array(100) { index ->
+        pool.execute(TransferMode.SAFE, { PoolArgument(index, if (index % 10 == 0) 100000 else 100) }) { input ->
+            var sum = 0L
+            for (i in 0 until input.work) {
+                sum += i
+            }
+            input.index to sum
+        }
+    }
+    futures.forEachIndexed { index, future ->
+        val (resultIndex, sum) = future.result
+        assertEquals(index, resultIndex)
+        val work = if (index % 10 == 0) 100000L else 100L
+        assertEquals(work * (work - 1) / 2, sum)
+    }
+
+    // Transferred object graph must be isolated, as for workers.
+    val shared = PoolArgument(0, 0)
+    assertFailsWith<IllegalStateException> {
+        pool.execute(TransferMode.SAFE, { shared }) { it }
+    }
+    assertEquals(0, shared.index)
+
+    pool.requestTermination().result
+    assertFailsWith<IllegalStateException> {
+        pool.execute(TransferMode.SAFE, { 1 }) { it }
+    }
+    println("OK")
+}
@@ -27,6 +27,7 @@ class RingLauncher(numWarmIterations: Int, numberOfAttempts: Int, prefix: String
     val classListBenchmark = ClassListBenchmark()
     val classStreamBenchmark = ClassStreamBenchmark()
     val companionObjectBenchmark = CompanionObjectBenchmark()
+    val cyclicGraphBenchmark = CyclicGraphBenchmark()
     val defaultArgumentBenchmark = DefaultArgumentBenchmark()
     val elvisBenchmark = ElvisBenchmark()
     val eulerBenchmark = EulerBenchmark()
@@ -95,6 +96,8 @@ class RingLauncher(numWarmIterations: Int, numberOfAttempts: Int, prefix: String
                     "ClassStream.reduce" to classStreamBenchmark::reduce,
                     "CompanionObject.invokeRegularFunction" to companionObjectBenchmark::invokeRegularFunction,
                     "CompanionObject.invokeJvmStaticFunction" to companionObjectBenchmark::invokeJvmStaticFunction,
+                    "CyclicGraph.collectTree" to cyclicGraphBenchmark::collectTree,
+                    "CyclicGraph.collectManyTrees" to cyclicGraphBenchmark::collectManyTrees,
                     "DefaultArgument.testOneOfTwo" to defaultArgumentBenchmark::testOneOfTwo,
                     "DefaultArgument.testTwoOfTwo" to defaultArgumentBenchmark::testTwoOfTwo,
                     "DefaultArgument.testOneOfFour" to defaultArgumentBenchmark::testOneOfFour,
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2010-2018 JetBrains s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package org.jetbrains.ring
+
+/**
+ * Builds pointer-heavy trees with back references to parents, so that dropping them leaves
+ * cyclic garbage, which is only reclaimed by the cycle collector run from cleanup().
+ */
+open class CyclicGraphBenchmark {
+
+    class Node(val parent: Node?) {
+        val children = arrayOfNulls<Node>(4)
+        var sibling: Node? = null
+    }
+
+    private fun buildTree(size: Int): Node {
+        val root = Node(null)
+        val nodes = arrayOfNulls<Node>(size)
+        nodes[0] = root
+        for (index in 1 until size) {
+            // Attach to a random node, so that tree is not laid out in memory in traversal order.
+            val parent = nodes[Random.nextInt(index)]!!
+            val node = Node(parent)
+            val slot = Random.nextInt(parent.children.size)
+            node.sibling = parent.children[slot]
+            parent.children[slot] = node
+            nodes[index] = node
+        }
+        return root
+    }
+
+    //Benchmark
+    fun collectTree() {
+        Blackhole.consume(buildTree(BENCHMARK_SIZE))
+        cleanup()
+    }
+
+    //Benchmark
+    fun collectManyTrees() {
+        for (i in 1..100) {
+            Blackhole.consume(buildTree(BENCHMARK_SIZE / 100))
+        }
+        cleanup()
+    }
+}
@@ -0,0 +1,322 @@
+/*
+ * Copyright 2010-2018 JetBrains s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#if !KONAN_WASM && !KONAN_ZEPHYR
+#include <stdio.h>
+#endif
+
+#include "Alloc.h"
+#include "AllocationProfiler.h"
+#include "Exceptions.h"
+#include "ExecFormat.h"
+#include "KString.h"
+#include "Memory.h"
+#include "Natives.h"
+#include "Porting.h"
+#include "Types.h"
+#include "Utils.h"
+
+int64_t allocationSamplingInterval = 0;
+THREAD_LOCAL_VARIABLE int64_t allocationBytesUntilSample = 0;
+
+namespace {
+
+// Sampling interval used if profiler is enabled by environment.
+constexpr int64_t kDefaultSamplingInterval = 512 * 1024;
+// Maximal number of stack frames kept per sample.
+constexpr int kMaxSampleDepth = 32;
+// Number of hash buckets of allocation sites.
+constexpr int kSiteBuckets = 4096;
+
+// Aggregated samples of allocations of the same type with the same stack.
+struct AllocationSite {
+  AllocationSite* next;
+  const TypeInfo* typeInfo;
+  int depth;
+  void* stack[kMaxSampleDepth];
+  // Estimated number of allocated objects and bytes.
+  uint64_t objects;
+  uint64_t bytes;
+};
+
+AllocationSite* sites[kSiteBuckets];
+SimpleMutex sitesMutex;
+// File to write profile to at exit, if any.
+const char* profilePath = nullptr;
+
+THREAD_LOCAL_VARIABLE uint32_t samplingSeed = 0;
+
+// Randomized around the sampling interval, so that periodic allocation patterns do not bias the profile.
+int64_t nextSamplingInterval(int64_t interval) {
+  if (samplingSeed == 0)
+    samplingSeed = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(&samplingSeed)) | 1;
+  // Xorshift.
+  samplingSeed ^= samplingSeed << 13;
+  samplingSeed ^= samplingSeed >> 17;
+  samplingSeed ^= samplingSeed << 5;
+  return interval / 2 + static_cast<int64_t>(samplingSeed % static_cast<uint64_t>(interval));
+}
+
+uint32_t siteHash(const TypeInfo* typeInfo, void* const* stack, int depth) {
+  uintptr_t hash = reinterpret_cast<uintptr_t>(typeInfo);
+  for (int index = 0; index < depth; ++index) {
+    hash = hash * 31 + reinterpret_cast<uintptr_t>(stack[index]);
+  }
+  return static_cast<uint32_t>(hash ^ (hash >> 32)) % kSiteBuckets;
+}
+
+// Minimal protocol buffers encoder, sufficient for profile.proto.
+class ProtoWriter {
+ public:
+  void varint(uint64_t value) {
+    while (value >= 0x80) {
+      buffer_.push_back(static_cast<uint8_t>(value | 0x80));
+      value >>= 7;
+    }
+    buffer_.push_back(static_cast<uint8_t>(value));
+  }
+
+  void uint64Field(int field, uint64_t value) {
+    varint(field << 3);
+    varint(value);
+  }
+
+  void bytesField(int field, const void* data, size_t size) {
+    varint((field << 3) | 2);
+    varint(size);
+    auto bytes = reinterpret_cast<const uint8_t*>(data);
+    buffer_.insert(buffer_.end(), bytes, bytes + size);
+  }
+
+  void messageField(int field, const ProtoWriter& message) {
+    bytesField(field, message.buffer_.data(), message.buffer_.size());
+  }
+
+  const KStdVector<uint8_t>& buffer() const { return buffer_; }
+
+ private:
+  KStdVector<uint8_t> buffer_;
+};
+
+// Builds profile.proto message, field numbers are from the pprof format definition.
+class ProfileBuilder {
+ public:
+  ProfileBuilder() {
+    // String table must start with an empty string.
+    string("");
+    valueType(1, "alloc_objects", "count");
+    valueType(1, "alloc_space", "bytes");
+    valueType(11, "space", "bytes");
+    profile_.uint64Field(12, allocationSamplingInterval);
+    typeLabel_ = string("type");
+  }
+
+  void sample(const AllocationSite* site) {
+    ProtoWriter sample;
+    ProtoWriter locations;
+    for (int index = 0; index < site->depth; ++index) {
+      locations.varint(location(site->stack[index]));
+    }
+    sample.messageField(1, locations);
+    ProtoWriter values;
+    values.varint(site->objects);
+    values.varint(site->bytes);
+    sample.messageField(2, values);
+    ProtoWriter label;
+    label.uint64Field(1, typeLabel_);
+    label.uint64Field(2, typeName(site->typeInfo));
+    sample.messageField(3, label);
+    profile_.messageField(2, sample);
+  }
+
+  const KStdVector<uint8_t>& build() {
+    return profile_.buffer();
+  }
+
+ private:
+  uint64_t string(const char* value) {
+    profile_.bytesField(6, value, strlen(value));
+    return strings_++;
+  }
+
+  void valueType(int field, const char* type, const char* unit) {
+    ProtoWriter message;
+    message.uint64Field(1, string(type));
+    message.uint64Field(2, string(unit));
+    profile_.messageField(field, message);
+  }
+
+  uint64_t typeName(const TypeInfo* typeInfo) {
+    auto it = types_.find(typeInfo);
+    if (it != types_.end()) return it->second;
+    char name[512];
+    FormatTypeName(typeInfo, name, sizeof(name));
+    auto result = string(name);
+    types_[typeInfo] = result;
+    return result;
+  }
+
+  // Every address gets its own location and function, named by the symbol containing it.
+  uint64_t location(void* address) {
+    auto it = locations_.find(address);
+    if (it != locations_.end()) return it->second;
+    uint64_t id = locations_.size() + 1;
+    locations_[address] = id;
+
+    char symbol[512];
+    if (!AddressToSymbol(address, symbol, sizeof(symbol)))
+      konan::snprintf(symbol, sizeof(symbol), "%p", address);
+    ProtoWriter function;
+    function.uint64Field(1, id);
+    auto name = string(symbol);
+    function.uint64Field(2, name);
+    function.uint64Field(3, name);
+    profile_.messageField(5, function);
+
+    ProtoWriter line;
+    line.uint64Field(1, id);
+    ProtoWriter location;
+    location.uint64Field(1, id);
+    location.uint64Field(3, reinterpret_cast<uintptr_t>(address));
+    location.messageField(4, line);
+    profile_.messageField(4, location);
+    return id;
+  }
+
+  ProtoWriter profile_;
+  uint64_t strings_ = 0;
+  // Key of the label naming type of allocated objects.
+  uint64_t typeLabel_ = 0;
+  KStdUnorderedMap<const TypeInfo*, uint64_t> types_;
+  KStdUnorderedMap<void*, uint64_t> locations_;
+};
+
+template <typename func>
+void buildProfile(func process) {
+  LockGuard<SimpleMutex> guard(sitesMutex);
+  ProfileBuilder builder;
+  for (int bucket = 0; bucket < kSiteBuckets; ++bucket) {
+    for (auto* site = sites[bucket]; site != nullptr; site = site->next) {
+      builder.sample(site);
+    }
+  }
+  process(builder.build());
+}
+
+}  // namespace
+
+void SampleAllocation(const TypeInfo* typeInfo, uint32_t size) {
+  int64_t interval = allocationSamplingInterval;
+  if (interval == 0) return;
+  if (size == 0) return;
+  // Bytes allocated past the sampling point count towards the next sample, unless taken by a large allocation.
+  int64_t overshoot = size < interval ? -allocationBytesUntilSample : 0;
+  allocationBytesUntilSample = nextSamplingInterval(interval) - overshoot;
+
+  void* stack[kMaxSampleDepth];
+  // Skip this function.
+  int depth = CaptureStackTrace(stack, kMaxSampleDepth, 1);
+  // Sample stands for all bytes allocated since the previous one.
+  uint64_t bytes = size < interval ? interval : size;
+  uint64_t objects = bytes / size;
+
+  auto bucket = siteHash(typeInfo, stack, depth);
+  LockGuard<SimpleMutex> guard(sitesMutex);
+  auto* site = sites[bucket];
+  while (site != nullptr) {
+    if (site->typeInfo == typeInfo && site->depth == depth &&
+        memcmp(site->stack, stack, depth * sizeof(void*)) == 0)
+      break;
+    site = site->next;
+  }
+  if (site == nullptr) {
+    site = konanConstructInstance<AllocationSite>();
+    site->typeInfo = typeInfo;
+    site->depth = depth;
+    memcpy(site->stack, stack, depth * sizeof(void*));
+    site->next = sites[bucket];
+    sites[bucket] = site;
+  }
+  site->objects += objects;
+  site->bytes += bytes;
+}
+
+void InitAllocationProfiler() {
+#if !KONAN_WASM && !KONAN_ZEPHYR
+  profilePath = getenv("KONAN_ALLOCATION_PROFILE");
+  if (profilePath == nullptr) return;
+  const char* interval = getenv("KONAN_ALLOCATION_SAMPLING_INTERVAL");
+  allocationSamplingInterval = interval != nullptr ? atoll(interval) : 0;
+  if (allocationSamplingInterval <= 0)
+    allocationSamplingInterval = kDefaultSamplingInterval;
+#endif
+}
+
+void DeinitAllocationProfiler() {
+#if !KONAN_WASM && !KONAN_ZEPHYR
+  if (profilePath == nullptr) return;
+  buildProfile([](const KStdVector<uint8_t>& profile) {
+    FILE* file = fopen(profilePath, "wb");
+    if (file == nullptr) {
+      konan::consolePrintf("Cannot write allocation profile to %s\n", profilePath);
+      return;
+    }
+    fwrite(profile.data(), 1, profile.size(), file);
+    fclose(file);
+  });
+#endif
+}
+
+extern "C" {
+
+KLong Kotlin_native_internal_AllocationProfiler_getSamplingInterval(KRef) {
+  return allocationSamplingInterval;
+}
+
+void Kotlin_native_internal_AllocationProfiler_setSamplingInterval(KRef, KLong value) {
+  if (value >= 0) {
+    allocationSamplingInterval = value;
+  }
+}
+
+OBJ_GETTER(Kotlin_native_internal_AllocationProfiler_dump, KRef) {
+  // Profile is built first, as allocating the result could take a sample.
+  KStdVector<uint8_t> result;
+  buildProfile([&result](const KStdVector<uint8_t>& profile) {
+    result = profile;
+  });
+  ArrayHeader* array = AllocArrayInstance(theByteArrayTypeInfo, result.size(), OBJ_RESULT)->array();
+  if (result.size() > 0)
+    memcpy(ByteArrayAddressOfElementAt(array, 0), result.data(), result.size());
+  return array->obj();
+}
+
+void Kotlin_native_internal_AllocationProfiler_reset(KRef) {
+  LockGuard<SimpleMutex> guard(sitesMutex);
+  for (int bucket = 0; bucket < kSiteBuckets; ++bucket) {
+    auto* site = sites[bucket];
+    while (site != nullptr) {
+      auto* next = site->next;
+      konanDestructInstance(site);
+      site = next;
+    }
+    sites[bucket] = nullptr;
+  }
+}
+
+}  // extern "C"
@@ -0,0 +1,56 @@
+/*
+ * Copyright 2010-2018 JetBrains s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RUNTIME_ALLOCATION_PROFILER_H
+#define RUNTIME_ALLOCATION_PROFILER_H
+
+#include <stdint.h>
+
+#include "Common.h"
+#include "Memory.h"
+
+// Sampling allocation profiler. Once per `allocationSamplingInterval` allocated bytes on average, allocation
+// is recorded along with its type and stack trace. Samples are aggregated into heap profile in pprof format,
+// which is written on demand, or at exit to the file named by KONAN_ALLOCATION_PROFILE environment variable.
+
+// Average number of bytes allocated between samples, zero if profiler is disabled.
+extern int64_t allocationSamplingInterval;
+// Number of bytes the current thread could allocate before the next sample.
+extern THREAD_LOCAL_VARIABLE int64_t allocationBytesUntilSample;
+
+// Records allocation of `size` bytes of `typeInfo` type.
+void SampleAllocation(const TypeInfo* typeInfo, uint32_t size);
+
+inline void ProfileObjectAllocation(const TypeInfo* typeInfo) {
+  if (allocationSamplingInterval != 0 && (allocationBytesUntilSample -= typeInfo->instanceSize_) < 0)
+    SampleAllocation(typeInfo, typeInfo->instanceSize_);
+}
+
+inline void ProfileArrayAllocation(const TypeInfo* typeInfo, uint32_t elements) {
+  if (allocationSamplingInterval != 0) {
+    // Element size is kept negated in the array type info.
+    uint32_t size = sizeof(ArrayHeader) - typeInfo->instanceSize_ * elements;
+    if ((allocationBytesUntilSample -= size) < 0)
+      SampleAllocation(typeInfo, size);
+  }
+}
+
+// Enables profiler if requested by environment, called on the first runtime initialization.
+void InitAllocationProfiler();
+// Writes the profile if requested by environment, called on the last runtime deinitialization.
+void DeinitAllocationProfiler();
+
+#endif // RUNTIME_ALLOCATION_PROFILER_H
@@ -106,9 +106,7 @@ void Kotlin_Array_fillImpl(KRef thiz, KInt fromIndex, KInt toIndex, KRef value)
     ThrowArrayIndexOutOfBoundsException();
   }
   mutabilityCheck(thiz);
-  for (KInt index = fromIndex; index < toIndex; ++index) {
-    UpdateRef(ArrayAddressOfElementAt(array, index), value);
-  }
+  FillRefRange(ArrayAddressOfElementAt(array, fromIndex), value, toIndex - fromIndex);
 }
 
 void Kotlin_Array_copyImpl(KConstRef thiz, KInt fromIndex,
@@ -121,17 +119,8 @@ void Kotlin_Array_copyImpl(KConstRef thiz, KInt fromIndex,
     ThrowArrayIndexOutOfBoundsException();
   }
   mutabilityCheck(destination);
-  if (fromIndex >= toIndex) {
-    for (int index = 0; index < count; index++) {
-      UpdateRef(ArrayAddressOfElementAt(destinationArray, toIndex + index),
-                      *ArrayAddressOfElementAt(array, fromIndex + index));
-    }
-  } else {
-    for (int index = count - 1; index >= 0; index--) {
-      UpdateRef(ArrayAddressOfElementAt(destinationArray, toIndex + index),
-                      *ArrayAddressOfElementAt(array, fromIndex + index));
-    }
-  }
+  UpdateRefRange(ArrayAddressOfElementAt(destinationArray, toIndex),
+                 ArrayAddressOfElementAt(array, fromIndex), count);
 }
 
 // Arrays.kt
@@ -182,14 +182,14 @@ void Kotlin_AtomicReference_checkIfFrozen(KRef value) {
 
 OBJ_GETTER(Kotlin_AtomicReference_compareAndSwap, KRef thiz, KRef expectedValue, KRef newValue) {
     Kotlin_AtomicReference_checkIfFrozen(newValue);
-    // See Kotlin_AtomicReference_get() for explanations, why locking is needed.
+    // See Kotlin_AtomicReference_get() for explanations, why locking is needed, readers don't take the lock.
     AtomicReferenceLayout* ref = asAtomicReference(thiz);
     RETURN_RESULT_OF(SwapRefLocked, &ref->value_, expectedValue, newValue, &ref->lock_);
 }
 
 KBoolean Kotlin_AtomicReference_compareAndSet(KRef thiz, KRef expectedValue, KRef newValue) {
     Kotlin_AtomicReference_checkIfFrozen(newValue);
-    // See Kotlin_AtomicReference_get() for explanations, why locking is needed.
+    // See Kotlin_AtomicReference_get() for explanations, why locking is needed, readers don't take the lock.
     AtomicReferenceLayout* ref = asAtomicReference(thiz);
     ObjHolder holder;
     auto old = SwapRefLocked(&ref->value_, expectedValue, newValue, &ref->lock_, holder.slot());
@@ -203,12 +203,12 @@ void Kotlin_AtomicReference_set(KRef thiz, KRef newValue) {
 }
 
 OBJ_GETTER(Kotlin_AtomicReference_get, KRef thiz) {
-    // Here we must take a lock to prevent race when value, while taken here, is CASed and immediately
+    // Here we must prevent race when value, while taken here, is CASed and immediately
     // destroyed by an another thread. AtomicReference no longer holds such an object, so if we got
     // rescheduled unluckily, between the moment value is read from the field and RC is incremented,
-    // object may go away.
+    // object may go away. Instead of taking a lock, the value is protected with a hazard pointer.
     AtomicReferenceLayout* ref = asAtomicReference(thiz);
-    RETURN_RESULT_OF(ReadRefLocked, &ref->value_, &ref->lock_);
+    RETURN_RESULT_OF(ReadRefLockFree, &ref->value_);
 }
 
 }  // extern "C"
@@ -25,6 +25,17 @@ ALWAYS_INLINE inline T compareAndSwap(volatile T* where, T expectedValue, T newV
 #endif
 }
 
+template <typename T>
+ALWAYS_INLINE inline T atomicExchange(volatile T* where, T what) {
+#ifndef KONAN_NO_THREADS
+  return __atomic_exchange_n(where, what, __ATOMIC_SEQ_CST);
+#else
+  T oldValue = *where;
+  *where = what;
+  return oldValue;
+#endif
+}
+
 template <typename T>
 ALWAYS_INLINE inline bool compareAndSet(volatile T* where, T expectedValue, T newValue) {
 #ifndef KONAN_NO_THREADS
@@ -60,4 +71,15 @@ ALWAYS_INLINE inline T atomicGet(volatile T* where) {
 #endif
 }
 
+// Hints the processor that the caller is spinning, waiting for another thread.
+ALWAYS_INLINE inline void spinPause() {
+#ifndef KONAN_NO_THREADS
+#if defined(__i386__) || defined(__x86_64__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__) || (defined(__arm__) && __ARM_ARCH >= 7)
+  __asm__ __volatile__("yield");
+#endif
+#endif
+}
+
 #endif // RUNTIME_ATOMIC_H
\ No newline at end of file
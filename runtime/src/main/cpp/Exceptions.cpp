@@ -113,10 +113,58 @@ _Unwind_Reason_Code unwindCallback(
 
   return _URC_NO_REASON;
 }
+
+struct RawBacktrace {
+  void** buffer;
+  int maxDepth;
+  int depth;
+  int skipCount;
+};
+
+_Unwind_Reason_Code rawUnwindCallback(
+    struct _Unwind_Context* context, void* arg) {
+  RawBacktrace* backtrace = reinterpret_cast<RawBacktrace*>(arg);
+  if (backtrace->skipCount > 0) {
+    backtrace->skipCount--;
+    return _URC_NO_REASON;
+  }
+  if (backtrace->depth >= backtrace->maxDepth) return _URC_END_OF_STACK;
+
+#if (__MINGW32__ || __MINGW64__)
+  _Unwind_Ptr address = _Unwind_GetRegionStart(context);
+#else
+  _Unwind_Ptr address = _Unwind_GetIP(context);
+#endif
+  backtrace->buffer[backtrace->depth++] = reinterpret_cast<void*>(address);
+
+  return _URC_NO_REASON;
+}
 #endif
 
 }  // namespace
 
+int CaptureStackTrace(void** buffer, int maxDepth, int skip) {
+#if OMIT_BACKTRACE
+  return 0;
+#elif USE_GCC_UNWIND
+  // Skip this function as well.
+  RawBacktrace backtrace = { buffer, maxDepth, 0, skip + 1 };
+  _Unwind_Backtrace(rawUnwindCallback, &backtrace);
+  return backtrace.depth;
+#else
+  constexpr int kMaxFrames = 64;
+  void* frames[kMaxFrames];
+  int size = backtrace(frames, kMaxFrames);
+  // Skip this function as well.
+  int first = skip + 1;
+  int depth = 0;
+  for (int index = first; index < size && depth < maxDepth; ++index) {
+    buffer[depth++] = frames[index];
+  }
+  return depth;
+#endif  // !OMIT_BACKTRACE
+}
+
 extern "C" {
 
 // TODO: this implementation is just a hack, e.g. the result is inexact;
@@ -64,6 +64,10 @@ void PrintThrowable(KRef);
 
 #ifdef __cplusplus
 } // extern "C"
+
+// Stores up to `maxDepth` return addresses of the current thread to `buffer`, skipping `skip` innermost frames
+// of the caller. Doesn't allocate Kotlin objects, so could be used by memory manager. Returns number of addresses.
+int CaptureStackTrace(void** buffer, int maxDepth, int skip);
 #endif
 
 #endif // RUNTIME_NAMES_H
@@ -0,0 +1,198 @@
+/*
+ * Copyright 2010-2018 JetBrains s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "Alloc.h"
+#include "Exceptions.h"
+#include "Memory.h"
+#include "MemoryPrivate.hpp"
+#include "Natives.h"
+#include "Types.h"
+
+/**
+ * Heap snapshot of the current thread.
+ *
+ * Snapshot is a sequence of unsigned LEB128 varints; strings are prefixed with their length in bytes.
+ * It starts with "KNHS" magic and format version, followed by records, each starting with its kind:
+ *   kTypeRecord: type id, name, type kind, number of reference fields and their names
+ *   kContainerRecord: container id, reference count, flags
+ *   kObjectRecord: object id, type id, container id, size in bytes, number of references,
+ *                  then field index (or element index for arrays) and referred object id for each
+ *   kStackRootRecord: object id
+ * Ids are addresses. Type record precedes records of objects of this type. Reference counts do not
+ * include references from local variables, which are reported as stack roots instead. References to
+ * objects not in the snapshot (permanent ones, or allocated by other threads) are kept as is.
+ * Retained sizes are computed offline, see tools/scripts/heap_snapshot_analyzer.py.
+ */
+
+namespace {
+
+constexpr char kSnapshotMagic[] = "KNHS";
+constexpr uint32_t kSnapshotVersion = 1;
+
+enum RecordKind {
+  kTypeRecord = 1,
+  kContainerRecord = 2,
+  kObjectRecord = 3,
+  kStackRootRecord = 4,
+};
+
+enum TypeKind {
+  kObjectType = 0,
+  kReferenceArrayType = 1,
+  // Primitive arrays and strings.
+  kPrimitiveArrayType = 2,
+};
+
+enum ContainerFlags {
+  kFrozenContainer = 1 << 0,
+};
+
+class SnapshotWriter : public HeapVisitor {
+ public:
+  SnapshotWriter() {
+    buffer_.insert(buffer_.end(), kSnapshotMagic, kSnapshotMagic + strlen(kSnapshotMagic));
+    varint(kSnapshotVersion);
+  }
+
+  void visitContainer(const ContainerHeader* container, uint32_t refCount) override {
+    varint(kContainerRecord);
+    id(container);
+    varint(refCount);
+    varint(container->frozen() ? kFrozenContainer : 0);
+  }
+
+  void visitObject(const ObjHeader* object, const ContainerHeader* container, uint32_t size) override {
+    const TypeInfo* typeInfo = object->type_info();
+    type(typeInfo);
+    varint(kObjectRecord);
+    id(object);
+    id(typeInfo);
+    id(container);
+    varint(size);
+    if (typeInfo == theArrayTypeInfo) {
+      const ArrayHeader* array = object->array();
+      const KRef* elements = ArrayAddressOfElementAt(array, 0);
+      uint32_t count = 0;
+      for (uint32_t index = 0; index < array->count_; ++index) {
+        if (elements[index] != nullptr) count++;
+      }
+      varint(count);
+      for (uint32_t index = 0; index < array->count_; ++index) {
+        if (elements[index] == nullptr) continue;
+        varint(index);
+        id(elements[index]);
+      }
+    } else {
+      uint32_t count = 0;
+      for (int32_t index = 0; index < typeInfo->objOffsetsCount_; ++index) {
+        if (field(object, typeInfo, index) != nullptr) count++;
+      }
+      varint(count);
+      for (int32_t index = 0; index < typeInfo->objOffsetsCount_; ++index) {
+        const ObjHeader* ref = field(object, typeInfo, index);
+        if (ref == nullptr) continue;
+        varint(index);
+        id(ref);
+      }
+    }
+  }
+
+  void visitStackRoot(const ObjHeader* object) override {
+    varint(kStackRootRecord);
+    id(object);
+  }
+
+  const KStdVector<uint8_t>& snapshot() const { return buffer_; }
+
+ private:
+  void varint(uint64_t value) {
+    while (value >= 0x80) {
+      buffer_.push_back(static_cast<uint8_t>(value | 0x80));
+      value >>= 7;
+    }
+    buffer_.push_back(static_cast<uint8_t>(value));
+  }
+
+  void id(const void* address) {
+    varint(reinterpret_cast<uintptr_t>(address));
+  }
+
+  void string(const char* value) {
+    auto size = strlen(value);
+    varint(size);
+    buffer_.insert(buffer_.end(), value, value + size);
+  }
+
+  static const ObjHeader* field(const ObjHeader* object, const TypeInfo* typeInfo, int32_t index) {
+    return *reinterpret_cast<const KRef*>(reinterpret_cast<uintptr_t>(object) + typeInfo->objOffsets_[index]);
+  }
+
+  // Names are only known if extended type info is generated for the type.
+  static const char* fieldName(const TypeInfo* typeInfo, int32_t offset) {
+    const ExtendedTypeInfo* extendedInfo = typeInfo->extendedInfo_;
+    if (extendedInfo == nullptr) return "";
+    for (int32_t index = 0; index < extendedInfo->fieldsCount_; ++index) {
+      if (extendedInfo->fieldOffsets_[index] == offset) return extendedInfo->fieldNames_[index];
+    }
+    return "";
+  }
+
+  void type(const TypeInfo* typeInfo) {
+    if (!types_.insert(typeInfo).second) return;
+    varint(kTypeRecord);
+    id(typeInfo);
+    char name[512];
+    FormatTypeName(typeInfo, name, sizeof(name));
+    string(name);
+    if (typeInfo == theArrayTypeInfo) {
+      varint(kReferenceArrayType);
+      varint(0);
+    } else if (typeInfo->instanceSize_ < 0) {
+      varint(kPrimitiveArrayType);
+      varint(0);
+    } else {
+      varint(kObjectType);
+      varint(typeInfo->objOffsetsCount_);
+      for (int32_t index = 0; index < typeInfo->objOffsetsCount_; ++index) {
+        string(fieldName(typeInfo, typeInfo->objOffsets_[index]));
+      }
+    }
+  }
+
+  KStdVector<uint8_t> buffer_;
+  KStdUnorderedSet<const TypeInfo*> types_;
+};
+
+}  // namespace
+
+extern "C" {
+
+OBJ_GETTER(Kotlin_native_internal_HeapSnapshot_dump, KRef) {
+  // Snapshot is built first, as heap must not change while it is walked.
+  KStdVector<uint8_t> result;
+  {
+    SnapshotWriter writer;
+    if (!VisitHeap(&writer)) ThrowIllegalStateException();
+    result = writer.snapshot();
+  }
+  ArrayHeader* array = AllocArrayInstance(theByteArrayTypeInfo, result.size(), OBJ_RESULT)->array();
+  memcpy(ByteArrayAddressOfElementAt(array, 0), result.data(), result.size());
+  return array->obj();
+}
+
+}  // extern "C"
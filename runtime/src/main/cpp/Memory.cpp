@@ -17,9 +17,11 @@
 #include <string.h>
 #include <stdio.h>
 
+#include <algorithm>
 #include <cstddef> // for offsetof
 
 #include "Alloc.h"
+#include "AllocationProfiler.h"
 #include "KAssert.h"
 #include "Atomic.h"
 #include "Exceptions.h"
@@ -40,6 +42,22 @@
 #define COLLECT_STATISTIC 0
 // Auto-adjust GC thresholds.
 #define GC_ERGONOMICS 1
+// Allocate small containers from per-thread size-class slabs instead of the system allocator.
+#define USE_CONTAINER_ALLOCATOR 1
+// Count references to frozen containers from the thread which froze them without atomic operations.
+// Owner-local counter is kept in the container block, so requires the container allocator.
+#if USE_CONTAINER_ALLOCATOR && !KONAN_NO_THREADS
+#define USE_BIASED_RC 1
+#else
+#define USE_BIASED_RC 0
+#endif
+// Don't count references from local variable slots, but account them when reference counts must be exact,
+// i.e. at collection, freezing and transfer checks. Containers with zero reference count are freed then.
+#if USE_GC
+#define USE_DEFERRED_STACK_RC 1
+#else
+#define USE_DEFERRED_STACK_RC 0
+#endif
 
 namespace {
 
@@ -47,6 +65,14 @@ namespace {
 constexpr container_size_t kContainerAlignment = 1024;
 // Single object alignment.
 constexpr container_size_t kObjectAlignment = 8;
+// Minimal capacity of arena container chunks, chunks of this size are reused.
+constexpr container_size_t kArenaChunkCapacity = 1024;
+// Arena chunks grow geometrically up to this capacity.
+constexpr container_size_t kArenaMaxChunkCapacity = 32 * 1024;
+// Objects of at least this size are placed in arena chunks of their own.
+constexpr container_size_t kArenaLargeObjectSize = 4 * 1024;
+// Maximal number of arena container chunks, and of frame arenas, kept for reuse by each thread.
+constexpr int kArenaChunkPoolSize = 16;
 
 // Required e.g. for object size computations to be correct.
 static_assert(sizeof(ContainerHeader) % kObjectAlignment == 0, "sizeof(ContainerHeader) is not aligned");
@@ -61,16 +87,28 @@ static_assert(sizeof(ContainerHeader) % kObjectAlignment == 0, "sizeof(Container
 // Collection threshold default (collect after having so many elements in the
 // release candidates set).
 constexpr size_t kGcThreshold = 4 * 1024;
+// Number of release candidates processed at once by incremental collection,
+// time budget is checked between such slices.
+constexpr size_t kGcSliceSize = 256;
+// Minimal number of containers with zero reference count triggering their reconciliation with the stack.
+constexpr size_t kZeroCountThreshold = 4 * 1024;
+// Time budget of a single collection slice run by an idle thread, in microseconds.
+constexpr uint64_t kIdleGcBudgetMicros = 1000;
+// Minimal interval between idle collections below the collection threshold, in microseconds.
+constexpr uint64_t kIdleGcIntervalMicros = 10000;
 #if GC_ERGONOMICS
 // Ergonomic thresholds.
 // If GC to computations time ratio is above that value,
 // increase GC threshold by 1.5 times.
 constexpr double kGcToComputeRatioThreshold = 0.5;
+// If GC to computations time ratio is below that value,
+// decay GC threshold towards the one set by user.
+constexpr double kGcToComputeRatioDecayThreshold = 0.05;
 // Never exceed this value when increasing GC threshold.
 constexpr size_t kMaxErgonomicThreshold = 1024 * 1024;
+// Never go below this value when decreasing GC threshold to meet target pause.
+constexpr size_t kMinErgonomicThreshold = 256;
 #endif  // GC_ERGONOMICS
-
-typedef KStdDeque<ContainerHeader*> ContainerHeaderDeque;
 #endif
 
 }  // namespace
@@ -82,7 +120,13 @@ typedef KStdVector<KRef*> KRefPtrList;
 #endif
 
 struct FrameOverlay {
+  // Arena of this frame, allocated on first use.
   ArenaContainer* arena;
+  // Next outer frame having local variable slots.
+  FrameOverlay* previous;
+  // Number of slots preceding local variable slots, and number of local variable slots.
+  int32_t count;
+  int32_t stackCount;
 };
 
 // A little hack that allows to enable -O2 optimizations
@@ -91,6 +135,15 @@ struct FrameOverlay {
 // Can be removed when FrameOverlay will become more complex.
 FrameOverlay exportFrameOverlay;
 
+#if USE_CONTAINER_ALLOCATOR
+class ContainerAllocator;
+#endif
+class MarkStack;
+struct HazardRecord;
+#if USE_BIASED_RC
+struct BiasOwner;
+#endif
+
 // Current number of allocated containers.
 int allocCount = 0;
 int aliveMemoryStatesCount = 0;
@@ -123,6 +176,12 @@ public:
   uint64_t atomicReleaseRefs;
   // Number of potential cycle candidates.
   uint64_t releaseCyclicRefs;
+  // Number of arena chunks, and how many of them hold a single large object.
+  uint64_t arenaChunks;
+  uint64_t arenaLargeChunks;
+  // Bytes of arena chunks allocated, and bytes left unused in them.
+  uint64_t arenaBytes;
+  uint64_t arenaWastedBytes;
 
   // Map of array index to human readable name.
   static constexpr const char* indexToName[] = {
@@ -176,6 +235,16 @@ public:
     objectAllocs[toIndex(header)][1]++;
   }
 
+  void incArenaChunk(size_t size, bool large) {
+    arenaChunks++;
+    if (large) arenaLargeChunks++;
+    arenaBytes += size;
+  }
+
+  void incArenaWaste(size_t size) {
+    arenaWastedBytes += size;
+  }
+
   static int toIndex(const ObjHeader* obj) {
     if (reinterpret_cast<uintptr_t>(obj) > 1)
         return toIndex(obj->container());
@@ -240,6 +309,10 @@ public:
                          addRefs, atomicAddRefs, percents(atomicAddRefs, allAddRefs),
                          releaseRefs, atomicReleaseRefs, percents(atomicAddRefs, allReleases),
                          releaseCyclicRefs, percents(releaseCyclicRefs, allReleases));
+
+    konan::consolePrintf("Arena chunks: %lld (%lld large), bytes: %lld, wasted: %lld (%lf%%)\n",
+                         arenaChunks, arenaLargeChunks, arenaBytes, arenaWastedBytes,
+                         percents(arenaWastedBytes, arenaBytes));
   }
 };
 
@@ -247,12 +320,88 @@ constexpr const char* MemoryStatistic::indexToName[];
 
 #endif  // COLLECT_STATISTIC
 
+// Number of allocation size classes: up to 16, 32, ..., 4096 bytes, and larger.
+constexpr int kAllocationSizeClasses = 10;
+
+// Cheap per-thread counters, always collected. Layout is mirrored by MemoryStatistics.kt.
+struct MemoryCounters {
+  // Bytes allocated in containers.
+  uint64_t allocatedBytes;
+  // Number of containers released to allocator.
+  uint64_t freedContainers;
+  // Number of regular and atomic reference increments and decrements.
+  uint64_t addRefs;
+  uint64_t atomicAddRefs;
+  uint64_t releaseRefs;
+  uint64_t atomicReleaseRefs;
+  // Number of collections, their total and maximal pause, in microseconds.
+  uint64_t gcRuns;
+  uint64_t gcPauseMicros;
+  uint64_t gcMaxPauseMicros;
+  // Maximal number of cycle collector release candidates.
+  uint64_t maxReleaseCandidates;
+  // Number of containers allocated by size class.
+  uint64_t allocations[kAllocationSizeClasses];
+
+  static int sizeClass(size_t size) {
+    if (size <= 16) return 0;
+    int result = 64 - __builtin_clzll(size - 1) - 4;
+    return result < kAllocationSizeClasses ? result : kAllocationSizeClasses - 1;
+  }
+
+  void incAlloc(size_t size) {
+    allocatedBytes += size;
+    allocations[sizeClass(size)]++;
+  }
+
+  void incRef(bool atomic) {
+    if (atomic) atomicAddRefs++; else addRefs++;
+  }
+
+  void decRef(bool atomic) {
+    if (atomic) atomicReleaseRefs++; else releaseRefs++;
+  }
+
+  void incGc(uint64_t pauseMicros) {
+    gcRuns++;
+    gcPauseMicros += pauseMicros;
+    if (pauseMicros > gcMaxPauseMicros) gcMaxPauseMicros = pauseMicros;
+  }
+
+  void updateReleaseCandidates(size_t count) {
+    if (count > maxReleaseCandidates) maxReleaseCandidates = count;
+  }
+};
+
 struct MemoryState {
 #if TRACE_MEMORY
   // Set of all containers.
   ContainerHeaderSet* containers;
 #endif
 
+#if USE_CONTAINER_ALLOCATOR
+  // Allocator for containers created by this thread.
+  ContainerAllocator* allocator;
+  // Innermost open transfer arena, containers are allocated there instead if set.
+  TransferArena* transferArena;
+#endif
+  // Containers to visit by object graph traversals.
+  MarkStack* markStack;
+  // Hazard record of this thread, if it has read shared references.
+  HazardRecord* hazardRecord;
+  // Zeroed arena container chunks of minimal size, kept for reuse.
+  ContainerChunk* arenaChunks;
+  int arenaChunksCount;
+  // Frame arenas kept for reuse, linked through their first word.
+  ArenaContainer* frameArenas;
+  int frameArenasCount;
+
+#if USE_BIASED_RC
+  // Owner record of containers frozen by this thread, and its id, zero if containers are not biased.
+  BiasOwner* biasOwner;
+  uint32_t biasOwnerId;
+#endif
+
 #if USE_GC
   // Finalizer queue - linked list of containers scheduled for finalization.
   ContainerHeader* finalizerQueue;
@@ -270,13 +419,43 @@ struct MemoryState {
   ContainerHeaderList* roots; // Real candidates excluding those with refcount = 0.
   // How many GC suspend requests happened.
   int gcSuspendCount;
+  // How many candidate elements at the beginning of toFree were already processed by collection.
+  size_t toFreeStart;
+  // How many candidate elements after toFreeStart are being collected.
+  size_t gcSliceSize;
   // How many candidate elements in toFree shall trigger collection.
   size_t gcThreshold;
+  // How many candidate elements were left by the last time bounded collection, they do not count towards threshold.
+  size_t gcLeftover;
+  // Time budget of automatically triggered collection, in microseconds, zero if unbounded.
+  uint64_t gcMaxPauseMicros;
+#if USE_DEFERRED_STACK_RC
+  // Containers with zero reference count, freed unless referenced from the stack.
+  ContainerHeaderList* zeroCount;
+  // How many zero count containers shall trigger reconciliation.
+  size_t zeroCountThreshold;
+#endif
   // If collection is in progress.
   bool gcInProgress;
+  // When idle collection was last run, in microseconds.
+  uint64_t lastIdleGcTimestamp;
 
 #if GC_ERGONOMICS
   uint64_t lastGcTimestamp;
+  // If GC threshold shall be adjusted automatically.
+  bool gcAutotune;
+  // GC threshold set by user, automatic adjustments decay towards it.
+  size_t gcBaseThreshold;
+  // Desired collection pause in microseconds, zero if none.
+  uint64_t gcTargetPauseMicros;
+  // Exponentially weighted average of recent collection pauses, in microseconds.
+  uint64_t gcAveragePauseMicros;
+  // Bytes allocated in containers since last collection.
+  uint64_t allocatedBytes;
+  // How many allocated bytes shall trigger collection, zero if unbounded.
+  uint64_t gcAllocationThreshold;
+  // Number of live containers after last collection.
+  int lastLiveContainers;
 #endif
 
 #endif // USE_GC
@@ -296,6 +475,10 @@ struct MemoryState {
       state->statistic.incAddRef(obj, atomic);
   #define UPDATE_RELEASEREF_STAT(state, obj, atomic, cyclic) \
         state->statistic.incReleaseRef(obj, atomic, cyclic);
+  #define ARENA_CHUNK_STAT(state, size, large) \
+    state->statistic.incArenaChunk(size, large);
+  #define ARENA_WASTE_STAT(state, size) \
+    state->statistic.incArenaWaste(size);
   #define INIT_STAT(state) \
     state->statistic.init();
   #define DEINIT_STAT(state) \
@@ -312,6 +495,8 @@ struct MemoryState {
   #define UPDATE_REF_STAT(state, oldRef, newRef, slot)
   #define UPDATE_ADDREF_STAT(state, obj, atomic)
   #define UPDATE_RELEASEREF_STAT(state, obj, atomic, cyclic)
+  #define ARENA_CHUNK_STAT(state, size, large)
+  #define ARENA_WASTE_STAT(state, size)
   #define INIT_STAT(state)
   #define DEINIT_STAT(state)
   #define PRINT_STAT(state)
@@ -341,6 +526,17 @@ struct MemoryState {
 #define UPDATE_REF_TRACE(state, oldRef, newRef, slot) \
   MEMORY_LOG("UpdateRef *%p: %p -> %p\n", slot, oldRef, newRef)
 
+// Counters are thread-local rather than in MemoryState, so that reference count updates
+// on threads without memory state are fine.
+#define CONTAINER_ALLOC_COUNT(size) \
+  memoryCounters.incAlloc(size);
+#define CONTAINER_DESTROY_COUNT() \
+  memoryCounters.freedContainers++;
+#define ADDREF_COUNT(atomic) \
+  memoryCounters.incRef(atomic);
+#define RELEASEREF_COUNT(atomic) \
+  memoryCounters.decRef(atomic);
+
 // Events macro definitions.
 // Called on worker's memory init.
 #define INIT_EVENT(state) \
@@ -352,7 +548,8 @@ struct MemoryState {
 // Called on container allocation.
 #define CONTAINER_ALLOC_EVENT(state, size, container) \
   CONTAINER_ALLOC_STAT(state, size, container) \
-  CONTAINER_ALLOC_TRACE(state, size, container)
+  CONTAINER_ALLOC_TRACE(state, size, container) \
+  CONTAINER_ALLOC_COUNT(size)
 // Called on container freeing (memory is still in use).
 #define CONTAINER_FREE_EVENT(state, container) \
   CONTAINER_FREE_STAT(state, container) \
@@ -360,7 +557,8 @@ struct MemoryState {
 // Called on container destroy (memory is released to allocator).
 #define CONTAINER_DESTROY_EVENT(state, container) \
   CONTAINER_DESTROY_STAT(state, container) \
-  CONTAINER_DESTROY_TRACE(state, container)
+  CONTAINER_DESTROY_TRACE(state, container) \
+  CONTAINER_DESTROY_COUNT()
 // Object was just allocated.
 #define OBJECT_ALLOC_EVENT(state, size, object) \
   OBJECT_ALLOC_STAT(state, size, object) \
@@ -369,6 +567,14 @@ struct MemoryState {
 #define OBJECT_FREE_EVENT(state, size, object)  \
   OBJECT_FREE_STAT(state, size, object) \
   OBJECT_FREE_TRACE(state, object)
+// Reference count is incremented.
+#define ADDREF_EVENT(state, container, atomic) \
+  UPDATE_ADDREF_STAT(state, container, atomic) \
+  ADDREF_COUNT(atomic)
+// Reference count is decremented.
+#define RELEASEREF_EVENT(state, container, atomic, cyclic) \
+  UPDATE_RELEASEREF_STAT(state, container, atomic, cyclic) \
+  RELEASEREF_COUNT(atomic)
 // Reference in memory is being updated.
 #define UPDATE_REF_EVENT(state, oldRef, newRef, slot) \
   UPDATE_REF_STAT(state, oldRef, newRef, slot) \
@@ -381,6 +587,12 @@ namespace {
 
 // TODO: can we pass this variable as an explicit argument?
 THREAD_LOCAL_VARIABLE MemoryState* memoryState = nullptr;
+THREAD_LOCAL_VARIABLE MemoryCounters memoryCounters;
+
+#if USE_DEFERRED_STACK_RC
+// Innermost frame having local variable slots.
+THREAD_LOCAL_VARIABLE FrameOverlay* currentFrame = nullptr;
+#endif
 
 constexpr int kFrameOverlaySlots = sizeof(FrameOverlay) / sizeof(ObjHeader**);
 
@@ -400,6 +612,11 @@ inline container_size_t alignUp(container_size_t size, int alignment) {
   return (size + alignment - 1) & ~(alignment - 1);
 }
 
+// Size of arena container chunk able to hold `capacity` bytes of objects.
+inline container_size_t arenaChunkSize(container_size_t capacity) {
+  return alignUp(capacity + sizeof(ContainerHeader) + sizeof(ContainerChunk), kContainerAlignment);
+}
+
 inline uint32_t arrayObjectSize(const TypeInfo* typeInfo, uint32_t count) {
   // Note: array body is aligned, but for size computation it is enough to align the sum.
   static_assert(kObjectAlignment % alignof(KLong) == 0, "");
@@ -440,7 +657,10 @@ inline bool isRefCounted(KConstRef object) {
 }
 
 inline void lock(KInt* spinlock) {
-  while (compareAndSwap(spinlock, 0, 1) != 0) {}
+  while (compareAndSwap(spinlock, 0, 1) != 0) {
+    // Wait reading, not to bounce the cache line between waiting threads.
+    while (atomicGet(spinlock) != 0) {}
+  }
 }
 
 inline void unlock(KInt* spinlock) {
@@ -449,6 +669,834 @@ inline void unlock(KInt* spinlock) {
 
 } // namespace
 
+#if USE_CONTAINER_ALLOCATOR
+
+/**
+ * Size-class allocator for containers.
+ *
+ * Every container allocated with AllocContainer() is preceded by ContainerBlock header. Small containers
+ * are carved from slabs owned by the allocating thread's MemoryState, segregated by size class, so
+ * allocation and release on the owning thread is a free list operation and never touches the global heap.
+ * Containers released by other threads (frozen or transferred objects) are pushed to the slab's lock-free
+ * remote free list, and returned to the owner's free lists when it runs out of blocks of the size class.
+ * When the owner's MemoryState is destroyed, slabs with live blocks are orphaned and released by whoever
+ * frees the last block. Large containers bypass slabs and are allocated directly, but released ones are kept
+ * in a bounded per-thread cache bucketed by size, so that containers of the same shape dying and being
+ * re-created again and again reuse the same, likely cached, memory.
+ */
+
+// Slab size, a few pages.
+constexpr uint32_t kSlabSize = 16 * 1024;
+// Granularity of size classes.
+constexpr uint32_t kSizeClassGranularity = 16;
+// Blocks bigger than that are allocated directly.
+constexpr uint32_t kMaxSlabBlockSize = 512;
+constexpr uint32_t kSizeClassCount = kMaxSlabBlockSize / kSizeClassGranularity;
+// Granularity of large block cache buckets.
+constexpr uint32_t kLargeBlockGranularity = 64;
+// Large blocks bigger than that are never cached.
+constexpr uint32_t kMaxCachedBlockSize = 16 * 1024;
+constexpr uint32_t kLargeBlockBucketCount = (kMaxCachedBlockSize - kMaxSlabBlockSize) / kLargeBlockGranularity;
+// Limits on the amount of memory kept in the large block cache.
+constexpr uint32_t kMaxCachedBlocksPerBucket = 16;
+constexpr uint32_t kMaxCachedBytes = 256 * 1024;
+// Set in ContainerBlock::slabOffset_ of directly allocated blocks, remaining bits keep block size.
+constexpr uint32_t kLargeBlockTag = 0x80000000u;
+// Set in ContainerBlock::slabOffset_ of blocks allocated in a transfer arena, remaining bits keep offset
+// of the block from the beginning of the arena chunk.
+constexpr uint32_t kArenaBlockTag = 0x40000000u;
+// Set in ContainerBlock::slabOffset_ of arena blocks once their containers are destroyed.
+constexpr uint32_t kArenaReleasedTag = 0x20000000u;
+
+struct ContainerSlab;
+struct TransferArenaChunk;
+
+struct ContainerBlock {
+  // Offset of the block from the beginning of the owning slab, or kLargeBlockTag with block size
+  // (zero if it doesn't fit) for directly allocated blocks.
+  uint32_t slabOffset_;
+  union {
+    // Index in the toFree list of the thread, while container is buffered as a cycle candidate.
+    uint32_t candidateIndex_;
+    // Owner id and owner-local reference count of biased frozen container.
+    uint32_t bias_;
+  };
+
+  ContainerHeader* asHeader() {
+    return reinterpret_cast<ContainerHeader*>(this + 1);
+  }
+
+  static ContainerBlock* fromHeader(ContainerHeader* header) {
+    return reinterpret_cast<ContainerBlock*>(header) - 1;
+  }
+
+  bool large() const {
+    return (slabOffset_ & kLargeBlockTag) != 0;
+  }
+
+  uint32_t largeSize() const {
+    return slabOffset_ & ~kLargeBlockTag;
+  }
+
+  void setLargeSize(uint32_t size) {
+    slabOffset_ = kLargeBlockTag | (size < kLargeBlockTag ? size : 0);
+  }
+
+  bool inTransferArena() const {
+    return (slabOffset_ & (kLargeBlockTag | kArenaBlockTag)) == kArenaBlockTag;
+  }
+
+  ContainerSlab* slab() {
+    return reinterpret_cast<ContainerSlab*>(reinterpret_cast<uint8_t*>(this) - slabOffset_);
+  }
+
+  TransferArenaChunk* arenaChunk() {
+    return reinterpret_cast<TransferArenaChunk*>(
+        reinterpret_cast<uint8_t*>(this) - (slabOffset_ & ~(kArenaBlockTag | kArenaReleasedTag)));
+  }
+
+  bool arenaReleased() const {
+    return (slabOffset_ & kArenaReleasedTag) != 0;
+  }
+
+  // Objects of destroyed container are overwritten, so arena block keeps its size to be stepped over.
+  void setArenaReleased(uint32_t size) {
+    slabOffset_ |= kArenaReleasedTag;
+    candidateIndex_ = size;
+  }
+
+  uint32_t arenaReleasedSize() const {
+    return candidateIndex_;
+  }
+
+  // Free blocks keep link to the next free block right after the block header.
+  void setNextFree(ContainerBlock* next) {
+    *reinterpret_cast<ContainerBlock**>(this + 1) = next;
+  }
+
+  ContainerBlock* nextFree() {
+    return *reinterpret_cast<ContainerBlock**>(this + 1);
+  }
+};
+
+static_assert(sizeof(ContainerBlock) % kObjectAlignment == 0, "sizeof(ContainerBlock) is not aligned");
+
+// Marker stored to the remote free list of a slab, once its owner is gone.
+ContainerBlock* const kOrphanedSlab = reinterpret_cast<ContainerBlock*>(1);
+
+// Directly allocated blocks are linked in the list of the allocating thread, so that they could be enumerated.
+struct LargeBlock {
+  LargeBlock* prev;
+  LargeBlock* next;
+  ContainerAllocator* owner;
+  uintptr_t reserved;
+  ContainerBlock block;
+
+  static LargeBlock* fromBlock(ContainerBlock* block) {
+    return reinterpret_cast<LargeBlock*>(reinterpret_cast<uint8_t*>(block) - offsetof(LargeBlock, block));
+  }
+};
+
+static_assert(offsetof(LargeBlock, block) % kObjectAlignment == 0, "LargeBlock::block is not aligned");
+
+struct ContainerSlab {
+  // Links in the list of all slabs of the owner.
+  ContainerSlab* prev;
+  ContainerSlab* next;
+  // Links in the list of slabs of the same size class having free blocks.
+  ContainerSlab* prevAvailable;
+  ContainerSlab* nextAvailable;
+  // Link in the owner's stack of slabs with remotely released blocks.
+  ContainerSlab* nextRemote;
+  ContainerAllocator* owner;
+  // Blocks released by the owner.
+  ContainerBlock* localFree;
+  // Blocks released by other threads, or kOrphanedSlab once the owner is gone.
+  ContainerBlock* volatile remoteFree;
+  // Never allocated tail of the slab.
+  uint8_t* bump;
+  uint8_t* end;
+  uint32_t blockSize;
+  uint32_t sizeClass;
+  // Number of blocks not in the local free list, only accessed by the owner.
+  uint32_t liveBlocks;
+  // If slab is in the list of slabs having free blocks.
+  bool available;
+  // If slab is in the owner's stack of slabs with remotely released blocks.
+  volatile int32_t queued;
+  // Number of other threads releasing blocks of the slab, which still could access it.
+  volatile int32_t remoteReleasers;
+  // Number of live blocks, once slab is orphaned.
+  volatile int32_t orphanedLive;
+
+  bool full() const {
+    return localFree == nullptr && bump + blockSize > end;
+  }
+};
+
+constexpr uint32_t kSlabHeaderSize = (sizeof(ContainerSlab) + kSizeClassGranularity - 1) & ~(kSizeClassGranularity - 1);
+
+/**
+ * Transfer arena keeps containers allocated by a thread while the arena is open in chunks of its own, so
+ * that an object graph built there is known to be separate from the rest of the heap, and is detached by
+ * a traversal bounded by the arena, see ClearArenaReferences(). Arena memory is bump allocated and never
+ * reused for other containers, instead every chunk counts its live blocks and is returned to the system
+ * by whichever thread frees the last of them. The arena itself goes away with its last chunk. Until then
+ * it is owned by the thread which opened it, or by the thread which adopted the object graph built there,
+ * see AdoptStablePointer(), and its containers are enumerated along with the containers of that thread.
+ */
+
+// Size of the first arena chunk, every next chunk is twice as big up to the limit.
+constexpr uint32_t kMinArenaChunkSize = 16 * 1024;
+constexpr uint32_t kMaxArenaChunkSize = 1024 * 1024;
+
+struct TransferArenaChunk {
+  TransferArena* arena;
+  // Links in the list of chunks of the arena, guarded by the arena lock.
+  TransferArenaChunk* prev;
+  TransferArenaChunk* next;
+  // End of the blocks allocated in the chunk.
+  uint8_t* top;
+  // Number of live blocks allocated in the chunk, plus one while the arena allocates from it.
+  volatile int32_t liveBlocks;
+};
+
+// Size of the arena container, as requested when it was allocated.
+inline container_size_t arenaContainerSize(const ContainerHeader* container) {
+  if (isAggregatingFrozenContainer(container))
+    return alignUp(sizeof(ContainerHeader) + sizeof(void*) * container->objectCount(), kObjectAlignment);
+  return sizeof(ContainerHeader) + objectSize(reinterpret_cast<const ObjHeader*>(container + 1));
+}
+
+constexpr uint32_t kArenaChunkHeaderSize =
+    (sizeof(TransferArenaChunk) + kObjectAlignment - 1) & ~(kObjectAlignment - 1);
+
+class TransferArena {
+ public:
+  TransferArena(TransferArena* previous, MemoryState* owner) : previous_(previous), owner_(owner) {
+    lock(&allLock_);
+    nextOfAll_ = all_;
+    if (all_ != nullptr) all_->prevOfAll_ = this;
+    all_ = this;
+    unlock(&allLock_);
+  }
+
+  ContainerHeader* allocate(container_size_t size) {
+    uint32_t blockSize = size + sizeof(ContainerBlock);
+    TransferArenaChunk* chunk;
+    uint8_t* place;
+    if (blockSize > kMaxArenaChunkSize / 4) {
+      // Large containers get chunks of their own, so that the tail of the current chunk is not wasted.
+      // Reference to the chunk held by the arena is passed to the container.
+      chunk = newChunk(kArenaChunkHeaderSize + blockSize);
+      place = reinterpret_cast<uint8_t*>(chunk) + kArenaChunkHeaderSize;
+    } else {
+      if (current_ == nullptr || static_cast<uint32_t>(end_ - bump_) < blockSize) {
+        auto* previous = current_;
+        current_ = newChunk(nextChunkSize_);
+        bump_ = reinterpret_cast<uint8_t*>(current_) + kArenaChunkHeaderSize;
+        end_ = reinterpret_cast<uint8_t*>(current_) + nextChunkSize_;
+        if (nextChunkSize_ < kMaxArenaChunkSize) nextChunkSize_ *= 2;
+        if (previous != nullptr) releaseChunk(previous);
+      }
+      chunk = current_;
+      place = bump_;
+      bump_ += blockSize;
+      atomicAdd(&chunk->liveBlocks, 1);
+    }
+    // Not guarded, as the arena is owned by the thread having it open, see adopt().
+    chunk->top = place + blockSize;
+    auto* block = reinterpret_cast<ContainerBlock*>(place);
+    block->slabOffset_ = kArenaBlockTag | static_cast<uint32_t>(place - reinterpret_cast<uint8_t*>(chunk));
+    return block->asHeader();
+  }
+
+  // If container was allocated in this arena.
+  bool contains(ContainerHeader* container) {
+    if (!container->normal()) return false;
+    auto* block = ContainerBlock::fromHeader(container);
+    return block->inTransferArena() && block->arenaChunk()->arena == this;
+  }
+
+  TransferArena* previous() const {
+    return previous_;
+  }
+
+  // Calls `process` with every container allocated in arenas owned by `state` and not yet destroyed, and
+  // the size available to it.
+  template <typename func>
+  static void forEachOwnedLive(MemoryState* state, func process) {
+    lock(&allLock_);
+    for (auto* arena = all_; arena != nullptr; arena = arena->nextOfAll_) {
+      if (arena->owner_ == state) arena->forEachLive(process);
+    }
+    unlock(&allLock_);
+  }
+
+  // Passes the closed arena `container` was allocated in, if any, to the thread adopting it.
+  static void adopt(ContainerHeader* container, MemoryState* state) {
+    if (container == nullptr || !container->normal()) return;
+    auto* block = ContainerBlock::fromHeader(container);
+    if (!block->inTransferArena()) return;
+    auto* arena = block->arenaChunk()->arena;
+    lock(&allLock_);
+    if (!arena->open_) arena->owner_ = state;
+    unlock(&allLock_);
+  }
+
+  // Called by the thread being destroyed, its arenas are no longer enumerated.
+  static void disown(MemoryState* state) {
+    lock(&allLock_);
+    for (auto* arena = all_; arena != nullptr; arena = arena->nextOfAll_) {
+      if (arena->owner_ == state) arena->owner_ = nullptr;
+    }
+    unlock(&allLock_);
+  }
+
+  // Called by any thread destroying container allocated in an arena, before its objects are overwritten.
+  static void markReleased(ContainerBlock* block, uint32_t size) {
+    auto* arena = block->arenaChunk()->arena;
+    lock(&arena->lock_);
+    block->setArenaReleased(size);
+    unlock(&arena->lock_);
+  }
+
+  // Called by any thread releasing container allocated in an arena.
+  static void release(ContainerBlock* block) {
+    releaseChunk(block->arenaChunk());
+  }
+
+  // Called by the thread closing the arena.
+  void close() {
+    lock(&allLock_);
+    open_ = false;
+    unlock(&allLock_);
+    if (current_ != nullptr) releaseChunk(current_);
+    current_ = nullptr;
+    releaseRef(this);
+  }
+
+ private:
+  // Calls `process` with every container allocated in the arena and not yet destroyed.
+  template <typename func>
+  void forEachLive(func process) {
+    lock(&lock_);
+    for (auto* chunk = chunks_; chunk != nullptr; chunk = chunk->next) {
+      auto* place = reinterpret_cast<uint8_t*>(chunk) + kArenaChunkHeaderSize;
+      while (place < chunk->top) {
+        auto* block = reinterpret_cast<ContainerBlock*>(place);
+        uint32_t size;
+        if (block->arenaReleased()) {
+          size = block->arenaReleasedSize();
+        } else {
+          size = arenaContainerSize(block->asHeader());
+          process(block->asHeader(), size);
+        }
+        place += sizeof(ContainerBlock) + size;
+      }
+    }
+    unlock(&lock_);
+  }
+
+  TransferArenaChunk* newChunk(uint32_t size) {
+    auto* chunk = reinterpret_cast<TransferArenaChunk*>(konanAllocMemory(size));
+    RuntimeCheck(chunk != nullptr, "Cannot allocate transfer arena chunk");
+    chunk->arena = this;
+    chunk->prev = nullptr;
+    chunk->top = reinterpret_cast<uint8_t*>(chunk) + kArenaChunkHeaderSize;
+    chunk->liveBlocks = 1;
+    atomicAdd(&refCount_, 1);
+    lock(&lock_);
+    chunk->next = chunks_;
+    if (chunks_ != nullptr) chunks_->prev = chunk;
+    chunks_ = chunk;
+    unlock(&lock_);
+    return chunk;
+  }
+
+  static void releaseChunk(TransferArenaChunk* chunk) {
+    if (atomicAdd(&chunk->liveBlocks, -1) != 0) return;
+    auto* arena = chunk->arena;
+    lock(&arena->lock_);
+    if (chunk->prev != nullptr)
+      chunk->prev->next = chunk->next;
+    else
+      arena->chunks_ = chunk->next;
+    if (chunk->next != nullptr) chunk->next->prev = chunk->prev;
+    unlock(&arena->lock_);
+    konanFreeMemory(chunk);
+    releaseRef(arena);
+  }
+
+  static void releaseRef(TransferArena* arena) {
+    if (atomicAdd(&arena->refCount_, -1) != 0) return;
+    RuntimeAssert(arena->chunks_ == nullptr, "All chunks must be released");
+    lock(&allLock_);
+    if (arena->prevOfAll_ != nullptr)
+      arena->prevOfAll_->nextOfAll_ = arena->nextOfAll_;
+    else
+      all_ = arena->nextOfAll_;
+    if (arena->nextOfAll_ != nullptr) arena->nextOfAll_->prevOfAll_ = arena->prevOfAll_;
+    unlock(&allLock_);
+    konanDestructInstance(arena);
+  }
+
+  // All arenas having live chunks, guarded by `allLock_`.
+  static TransferArena* all_;
+  static KInt allLock_;
+
+  // Arena opened by the same thread earlier, which was current when this one was opened.
+  TransferArena* previous_;
+  // Thread enumerating containers of the arena, if it is still being allocated in, and links in the list
+  // of all arenas, guarded by `allLock_`.
+  MemoryState* owner_;
+  bool open_ = true;
+  TransferArena* prevOfAll_ = nullptr;
+  TransferArena* nextOfAll_ = nullptr;
+  // Chunks having live blocks, guarded by `lock_`.
+  TransferArenaChunk* chunks_ = nullptr;
+  // Never allocated tail of the current chunk.
+  TransferArenaChunk* current_ = nullptr;
+  uint8_t* bump_ = nullptr;
+  uint8_t* end_ = nullptr;
+  uint32_t nextChunkSize_ = kMinArenaChunkSize;
+  // Number of chunks, plus one while the arena is open.
+  volatile int32_t refCount_ = 1;
+  // Guards the chunk list and released marks of the blocks, so that they could be walked.
+  KInt lock_ = 0;
+};
+
+TransferArena* TransferArena::all_ = nullptr;
+KInt TransferArena::allLock_ = 0;
+
+class ContainerAllocator {
+ public:
+  ContainerHeader* allocate(container_size_t size) {
+    container_size_t blockSize = size + sizeof(ContainerBlock);
+    if (blockSize > kMaxSlabBlockSize) return allocateLarge(blockSize + offsetof(LargeBlock, block));
+    uint32_t sizeClass = (blockSize - 1) / kSizeClassGranularity;
+    auto* slab = available_[sizeClass];
+    if (slab == nullptr) {
+      drainRemoteFrees();
+      slab = available_[sizeClass];
+      if (slab == nullptr) {
+        slab = newSlab(sizeClass);
+        if (slab == nullptr) return nullptr;
+      }
+    }
+    auto* block = slab->localFree;
+    if (block != nullptr) {
+      slab->localFree = block->nextFree();
+      // Memory of reused block must look like fresh calloc()'ed one.
+      memset(block, 0, blockSize);
+    } else {
+      // Tail of the slab is zeroed already.
+      block = reinterpret_cast<ContainerBlock*>(slab->bump);
+      slab->bump += slab->blockSize;
+    }
+    block->slabOffset_ = reinterpret_cast<uint8_t*>(block) - reinterpret_cast<uint8_t*>(slab);
+    slab->liveBlocks++;
+    if (slab->full()) unlinkAvailable(slab);
+    return block->asHeader();
+  }
+
+  // Releases container allocated by any allocator, `current` is an allocator of the calling thread.
+  static void release(ContainerAllocator* current, ContainerHeader* container) {
+    auto* block = ContainerBlock::fromHeader(container);
+    if (block->large()) {
+      releaseLarge(current, block);
+      return;
+    }
+    if (block->inTransferArena()) {
+      TransferArena::release(block);
+      return;
+    }
+    auto* slab = block->slab();
+    if (slab->owner == current)
+      current->releaseLocal(slab, block);
+    else
+      releaseRemote(slab, block);
+  }
+
+  // Calls `process` with every live container allocated by this allocator and the size available to it,
+  // zero if unknown. Must be called by the owner. Containers concurrently released by other threads
+  // could still be reported, so only their objects' headers are safe to read.
+  template <typename func>
+  void forEachLive(func process) {
+    drainRemoteFrees();
+    KStdVector<bool> released;
+    for (auto* slab = slabs_; slab != nullptr; slab = slab->next) {
+      auto* begin = reinterpret_cast<uint8_t*>(slab) + kSlabHeaderSize;
+      released.assign((slab->bump - begin) / slab->blockSize, false);
+      for (auto* block = slab->localFree; block != nullptr; block = block->nextFree()) {
+        released[(reinterpret_cast<uint8_t*>(block) - begin) / slab->blockSize] = true;
+      }
+      for (size_t index = 0; index < released.size(); ++index) {
+        if (released[index]) continue;
+        auto* block = reinterpret_cast<ContainerBlock*>(begin + index * slab->blockSize);
+        process(block->asHeader(), slab->blockSize - sizeof(ContainerBlock));
+      }
+    }
+    // Other threads releasing large blocks wait meanwhile, so that blocks are not freed under our feet.
+    lock(&largeLock_);
+    for (auto* large = largeBlocks_; large != nullptr; large = large->next) {
+      auto blockSize = large->block.largeSize();
+      process(large->block.asHeader(), blockSize != 0 ? blockSize - sizeof(LargeBlock) : 0);
+    }
+    unlock(&largeLock_);
+  }
+
+  // Called once owning memory state is destroyed. Allocator itself is destroyed
+  // when the last block is released.
+  void orphan() {
+    clearLargeCache();
+    drainRemoteFrees();
+    auto* slab = slabs_;
+    while (slab != nullptr) {
+      auto* next = slab->next;
+      // No remote releases are queued to the slab after that.
+      auto* block = atomicExchange(&slab->remoteFree, kOrphanedSlab);
+      // Released blocks could be already seen, while their releasers still access the slab.
+      while (atomicGet(&slab->remoteReleasers) != 0) {}
+      while (block != nullptr) {
+        slab->liveBlocks--;
+        block = block->nextFree();
+      }
+      if (slab->liveBlocks == 0 || atomicAdd(&slab->orphanedLive, static_cast<int32_t>(slab->liveBlocks)) == 0) {
+        destroyOrphanedSlab(slab);
+      }
+      slab = next;
+    }
+    releaseRef(this);
+  }
+
+ private:
+  static uint32_t largeBucket(uint32_t blockSize) {
+    return (blockSize - kMaxSlabBlockSize - 1) / kLargeBlockGranularity;
+  }
+
+  // `blockSize` includes links of the large block.
+  ContainerHeader* allocateLarge(uint32_t blockSize) {
+    LargeBlock* large = nullptr;
+    if (blockSize <= kMaxCachedBlockSize) {
+      // Round up, so that any block from the bucket fits.
+      blockSize = (blockSize + kLargeBlockGranularity - 1) & ~(kLargeBlockGranularity - 1);
+      auto bucket = largeBucket(blockSize);
+      large = largeCache_[bucket];
+      if (large != nullptr) {
+        largeCache_[bucket] = large->next;
+        largeCacheCount_[bucket]--;
+        largeCacheBytes_ -= blockSize;
+        memset(large, 0, blockSize);
+      }
+    }
+    if (large == nullptr) {
+      large = reinterpret_cast<LargeBlock*>(konanAllocMemory(blockSize));
+      if (large == nullptr) return nullptr;
+    }
+    large->block.setLargeSize(blockSize);
+    linkLarge(large);
+    return large->block.asHeader();
+  }
+
+  // Large blocks could be released by any thread, so the list is guarded by a lock, and every block keeps
+  // its owner alive, as slabs do.
+  void linkLarge(LargeBlock* large) {
+    atomicAdd(&refCount_, 1);
+    large->owner = this;
+    large->prev = nullptr;
+    lock(&largeLock_);
+    large->next = largeBlocks_;
+    if (largeBlocks_ != nullptr) largeBlocks_->prev = large;
+    largeBlocks_ = large;
+    unlock(&largeLock_);
+  }
+
+  static void unlinkLarge(LargeBlock* large) {
+    auto* owner = large->owner;
+    lock(&owner->largeLock_);
+    if (large->prev != nullptr)
+      large->prev->next = large->next;
+    else
+      owner->largeBlocks_ = large->next;
+    if (large->next != nullptr) large->next->prev = large->prev;
+    unlock(&owner->largeLock_);
+    releaseRef(owner);
+  }
+
+  // Released large blocks are cached by the releasing thread.
+  static void releaseLarge(ContainerAllocator* current, ContainerBlock* block) {
+    auto* large = LargeBlock::fromBlock(block);
+    unlinkLarge(large);
+    auto blockSize = block->largeSize();
+    if (current != nullptr && blockSize != 0 && blockSize <= kMaxCachedBlockSize &&
+        current->largeCacheBytes_ + blockSize <= kMaxCachedBytes) {
+      auto bucket = largeBucket(blockSize);
+      if (current->largeCacheCount_[bucket] < kMaxCachedBlocksPerBucket) {
+        large->next = current->largeCache_[bucket];
+        current->largeCache_[bucket] = large;
+        current->largeCacheCount_[bucket]++;
+        current->largeCacheBytes_ += blockSize;
+        return;
+      }
+    }
+    konanFreeMemory(large);
+  }
+
+  void clearLargeCache() {
+    for (uint32_t bucket = 0; bucket < kLargeBlockBucketCount; ++bucket) {
+      auto* large = largeCache_[bucket];
+      while (large != nullptr) {
+        auto* next = large->next;
+        konanFreeMemory(large);
+        large = next;
+      }
+      largeCache_[bucket] = nullptr;
+      largeCacheCount_[bucket] = 0;
+    }
+    largeCacheBytes_ = 0;
+  }
+
+  ContainerSlab* newSlab(uint32_t sizeClass) {
+    auto* slab = reinterpret_cast<ContainerSlab*>(konanAllocMemory(kSlabSize));
+    if (slab == nullptr) return nullptr;
+    atomicAdd(&refCount_, 1);
+    slab->owner = this;
+    slab->sizeClass = sizeClass;
+    slab->blockSize = (sizeClass + 1) * kSizeClassGranularity;
+    slab->bump = reinterpret_cast<uint8_t*>(slab) + kSlabHeaderSize;
+    slab->end = reinterpret_cast<uint8_t*>(slab) + kSlabSize;
+    slab->next = slabs_;
+    if (slabs_ != nullptr) slabs_->prev = slab;
+    slabs_ = slab;
+    linkAvailable(slab);
+    return slab;
+  }
+
+  void destroySlab(ContainerSlab* slab) {
+    if (slab->available) unlinkAvailable(slab);
+    if (slab->prev != nullptr)
+      slab->prev->next = slab->next;
+    else
+      slabs_ = slab->next;
+    if (slab->next != nullptr) slab->next->prev = slab->prev;
+    konanFreeMemory(slab);
+    atomicAdd(&refCount_, -1);
+  }
+
+  static void destroyOrphanedSlab(ContainerSlab* slab) {
+    auto* owner = slab->owner;
+    konanFreeMemory(slab);
+    releaseRef(owner);
+  }
+
+  static void releaseRef(ContainerAllocator* allocator) {
+    if (atomicAdd(&allocator->refCount_, -1) == 0)
+      konanFreeMemory(allocator);
+  }
+
+  void linkAvailable(ContainerSlab* slab) {
+    auto*& head = available_[slab->sizeClass];
+    slab->prevAvailable = nullptr;
+    slab->nextAvailable = head;
+    if (head != nullptr) head->prevAvailable = slab;
+    head = slab;
+    slab->available = true;
+  }
+
+  void unlinkAvailable(ContainerSlab* slab) {
+    if (slab->prevAvailable != nullptr)
+      slab->prevAvailable->nextAvailable = slab->nextAvailable;
+    else
+      available_[slab->sizeClass] = slab->nextAvailable;
+    if (slab->nextAvailable != nullptr) slab->nextAvailable->prevAvailable = slab->prevAvailable;
+    slab->prevAvailable = slab->nextAvailable = nullptr;
+    slab->available = false;
+  }
+
+  void releaseLocal(ContainerSlab* slab, ContainerBlock* block) {
+    block->setNextFree(slab->localFree);
+    slab->localFree = block;
+    slab->liveBlocks--;
+    if (slab->liveBlocks == 0 && atomicGet(&slab->queued) == 0 && atomicGet(&slab->remoteReleasers) == 0) {
+      // Keep single empty slab per size class to avoid trashing.
+      auto* head = available_[slab->sizeClass];
+      if (head != nullptr && (head != slab || slab->nextAvailable != nullptr)) {
+        destroySlab(slab);
+        return;
+      }
+    }
+    if (!slab->available) linkAvailable(slab);
+  }
+
+  static void releaseRemote(ContainerSlab* slab, ContainerBlock* block) {
+    // Owner cannot go away while we hold a live block of its slab, and once the block is released,
+    // neither the slab nor the owner are destroyed until we are done.
+    atomicAdd(&slab->remoteReleasers, 1);
+    auto* owner = slab->owner;
+    ContainerBlock* head;
+    do {
+      head = slab->remoteFree;
+      if (head == kOrphanedSlab) break;
+      block->setNextFree(head);
+    } while (!compareAndSet(&slab->remoteFree, head, block));
+    if (head == kOrphanedSlab) {
+      atomicAdd(&slab->remoteReleasers, -1);
+      if (atomicAdd(&slab->orphanedLive, -1) == 0)
+        destroyOrphanedSlab(slab);
+      return;
+    }
+    // Slab is queued after the block is published, so the owner either still has it queued and will
+    // see the block, or has already reset the flag and we queue it again.
+    if (compareAndSwap(&slab->queued, 0, 1) == 0) {
+      ContainerSlab* top;
+      do {
+        top = owner->remoteSlabs_;
+        slab->nextRemote = top;
+      } while (!compareAndSet(&owner->remoteSlabs_, top, slab));
+    }
+    atomicAdd(&slab->remoteReleasers, -1);
+  }
+
+  void drainRemoteFrees() {
+    if (atomicGet(&remoteSlabs_) == nullptr) return;
+    auto* slab = atomicExchange(&remoteSlabs_, static_cast<ContainerSlab*>(nullptr));
+    while (slab != nullptr) {
+      // Slab could be queued again once flag is reset.
+      auto* next = slab->nextRemote;
+      atomicSet(&slab->queued, 0);
+      auto* block = atomicExchange(&slab->remoteFree, static_cast<ContainerBlock*>(nullptr));
+      while (block != nullptr) {
+        auto* nextBlock = block->nextFree();
+        releaseLocal(slab, block);
+        block = nextBlock;
+      }
+      slab = next;
+    }
+  }
+
+  // All slabs of this allocator.
+  ContainerSlab* slabs_;
+  // Slabs with free blocks, per size class.
+  ContainerSlab* available_[kSizeClassCount];
+  // Slabs with remotely released blocks.
+  ContainerSlab* volatile remoteSlabs_;
+  // Live large blocks allocated by this allocator, guarded by `largeLock_`.
+  LargeBlock* largeBlocks_;
+  KInt largeLock_;
+  // Recently released large blocks, per size bucket.
+  LargeBlock* largeCache_[kLargeBlockBucketCount];
+  uint32_t largeCacheCount_[kLargeBlockBucketCount];
+  uint32_t largeCacheBytes_;
+  // Owning memory state and each slab keep allocator alive.
+  volatile int32_t refCount_ = 1;
+};
+
+#endif  // USE_CONTAINER_ALLOCATOR
+
+#if USE_BIASED_RC
+// Biased reference counting: references to a frozen container from its owner thread are counted
+// in ContainerBlock::bias_ with plain arithmetic, references from other threads are counted atomically
+// in ContainerHeader::refCount_. Container is alive while sum of both is positive. Only the owner
+// may see the sum dropping to zero, as other threads never decrement the shared counter below one,
+// but hand the reference over to the owner instead. Once the owner is gone, its local counts are
+// merged to the shared counters by other threads on demand.
+
+// Upper bits of ContainerBlock::bias_ keep owner id, lower bits keep owner-local reference count.
+constexpr uint32_t kBiasOwnerShift = 20;
+constexpr uint32_t kBiasLocalMask = (1u << kBiasOwnerShift) - 1;
+// Owner ids are not reused, threads started after that many do not bias containers.
+constexpr uint32_t kMaxBiasOwners = 1u << (32 - kBiasOwnerShift);
+
+// Reference to a biased container, released by another thread and awaiting release by the owner.
+struct BiasedRelease {
+  ContainerHeader* container;
+  BiasedRelease* next;
+};
+
+struct BiasOwner {
+  // Guards merging of local counters to the shared ones, once the owner has exited.
+  KInt lock;
+  // Stack of handed over references, or kDeadBiasOwner once the owner has exited.
+  BiasedRelease* volatile releases;
+};
+
+BiasedRelease* const kDeadBiasOwner = reinterpret_cast<BiasedRelease*>(1);
+
+// Owner records are never freed, as containers may outlive their owners.
+BiasOwner* biasOwners[kMaxBiasOwners];
+// Last assigned owner id, zero is never used.
+uint32_t lastBiasOwnerId = 0;
+
+#endif  // USE_BIASED_RC
+
+// Number of entries in one mark stack chunk.
+constexpr size_t kMarkStackChunkSize = 1024;
+
+struct MarkStackChunk {
+  MarkStackChunk* prev;
+  MarkStackChunk* next;
+  ContainerHeader* items[kMarkStackChunkSize];
+};
+
+/**
+ * Stack of containers to visit, shared by all object graph traversals of the thread.
+ * Memory is allocated in chunks, which are never released until the stack itself is destroyed,
+ * so traversals do not allocate once the stack has grown to the size of the largest graph.
+ * Traversals may nest (i.e. be called from the code run by another traversal), so each traversal
+ * only pops entries above the size of the stack it has started with.
+ */
+class MarkStack {
+ public:
+  ~MarkStack() {
+    auto* chunk = first_;
+    while (chunk != nullptr) {
+      auto* next = chunk->next;
+      konanFreeMemory(chunk);
+      chunk = next;
+    }
+  }
+
+  size_t size() const { return size_; }
+
+  void push(ContainerHeader* container) {
+    if (current_ == nullptr || top_ == current_->items + kMarkStackChunkSize) nextChunk();
+    *top_++ = container;
+    size_++;
+  }
+
+  ContainerHeader* pop() {
+    RuntimeAssert(size_ > 0, "Mark stack is empty");
+    if (top_ == current_->items) {
+      current_ = current_->prev;
+      top_ = current_->items + kMarkStackChunkSize;
+    }
+    size_--;
+    return *--top_;
+  }
+
+ private:
+  void nextChunk() {
+    auto* next = current_ == nullptr ? first_ : current_->next;
+    if (next == nullptr) {
+      next = reinterpret_cast<MarkStackChunk*>(konanAllocMemory(sizeof(MarkStackChunk)));
+      RuntimeCheck(next != nullptr, "Cannot grow mark stack");
+      next->prev = current_;
+      if (current_ == nullptr)
+        first_ = next;
+      else
+        current_->next = next;
+    }
+    current_ = next;
+    top_ = next->items;
+  }
+
+  MarkStackChunk* first_ = nullptr;
+  MarkStackChunk* current_ = nullptr;
+  ContainerHeader** top_ = nullptr;
+  size_t size_ = 0;
+};
+
 void KRefSharedHolder::initRefOwner() {
   RuntimeAssert(owner_ == nullptr, "Must be uninitialized");
   owner_ = memoryState;
@@ -531,6 +1579,44 @@ inline void traverseContainerReferredObjects(ContainerHeader* container, func pr
   });
 }
 
+// Number of referred objects prefetched ahead of their processing.
+constexpr int kPrefetchWindow = 8;
+static_assert((kPrefetchWindow & (kPrefetchWindow - 1)) == 0, "Prefetch window must be a power of two");
+
+// Same as traverseContainerReferredObjects(), but `process` is called with a delay of few objects, which are
+// prefetched meanwhile, so that cache misses on object headers during graph traversal overlap.
+// Objects are processed in the same order.
+template<typename func>
+inline void traverseContainerReferredObjectsPrefetching(ContainerHeader* container, func process) {
+  ObjHeader* window[kPrefetchWindow];
+  int head = 0;
+  int count = 0;
+  traverseContainerObjectFields(container, [&process, &window, &head, &count](ObjHeader** location) {
+    ObjHeader* ref = *location;
+    if (ref == nullptr) return;
+    __builtin_prefetch(ref);
+    if (count < kPrefetchWindow) {
+      window[(head + count++) & (kPrefetchWindow - 1)] = ref;
+    } else {
+      process(window[head]);
+      window[head] = ref;
+      head = (head + 1) & (kPrefetchWindow - 1);
+    }
+  });
+  for (; count > 0; --count) {
+    process(window[head]);
+    head = (head + 1) & (kPrefetchWindow - 1);
+  }
+}
+
+inline void freeContainerMemory(MemoryState* state, ContainerHeader* container) {
+#if USE_CONTAINER_ALLOCATOR
+  ContainerAllocator::release(state->allocator, container);
+#else
+  konanFreeMemory(container);
+#endif
+}
+
 #if USE_GC
 
 inline bool isMarkedAsRemoved(ContainerHeader* container) {
@@ -546,8 +1632,55 @@ inline ContainerHeader* clearRemoved(ContainerHeader* container) {
     reinterpret_cast<uintptr_t>(container) & ~static_cast<uintptr_t>(1));
 }
 
+inline void addCandidate(MemoryState* state, ContainerHeader* container) {
+  container->setBuffered();
+#if USE_CONTAINER_ALLOCATOR
+  ContainerBlock::fromHeader(container)->candidateIndex_ = state->toFree->size();
+#endif
+  state->toFree->push_back(container);
+  memoryCounters.updateReleaseCandidates(state->toFree->size());
+}
+
+#if USE_CONTAINER_ALLOCATOR
+// Removes buffered container from the cycle candidates list, using index kept in the block header.
+inline void removeCandidate(MemoryState* state, ContainerHeader* container) {
+  RuntimeAssert(container->buffered(), "Must be a cycle candidate");
+  container->resetBuffered();
+  auto& candidate = (*state->toFree)[ContainerBlock::fromHeader(container)->candidateIndex_];
+  RuntimeAssert(candidate == container, "Inconsistent candidate index");
+  candidate = markAsRemoved(container);
+}
+
+// Updates candidate indices after toFree has been shifted.
+inline void reindexCandidates(MemoryState* state) {
+  auto& toFree = *state->toFree;
+  for (size_t index = 0; index < toFree.size(); ++index) {
+    auto* container = toFree[index];
+    if (!isMarkedAsRemoved(container))
+      ContainerBlock::fromHeader(container)->candidateIndex_ = index;
+  }
+}
+#endif
+
+// Drops candidates already processed by collection. Remaining ones are only shifted once processed
+// candidates are the majority, so that incremental collection stays linear in number of candidates.
+inline void compactCandidates(MemoryState* state) {
+  auto& toFree = *state->toFree;
+  if (state->toFreeStart == toFree.size()) {
+    toFree.clear();
+  } else if (state->toFreeStart * 2 >= toFree.size()) {
+    toFree.erase(toFree.begin(), toFree.begin() + state->toFreeStart);
+#if USE_CONTAINER_ALLOCATOR
+    reindexCandidates(state);
+#endif
+  } else {
+    return;
+  }
+  state->toFreeStart = 0;
+}
+
 inline void processFinalizerQueue(MemoryState* state) {
-  // TODO: reuse elements of finalizer queue for new allocations.
+  // With USE_CONTAINER_ALLOCATOR released memory is recycled for new allocations of the same size.
   while (state->finalizerQueue != nullptr) {
     auto* container = state->finalizerQueue;
     state->finalizerQueue = container->nextLink();
@@ -556,7 +1689,7 @@ inline void processFinalizerQueue(MemoryState* state) {
     state->containers->erase(container);
 #endif
     CONTAINER_DESTROY_EVENT(state, container)
-    konanFreeMemory(container);
+    freeContainerMemory(state, container);
     atomicAdd(&allocCount, -1);
   }
   RuntimeAssert(state->finalizerQueueSize == 0, "Queue must be empty here");
@@ -564,6 +1697,10 @@ inline void processFinalizerQueue(MemoryState* state) {
 #endif
 
 inline void scheduleDestroyContainer(MemoryState* state, ContainerHeader* container) {
+#if USE_CONTAINER_ALLOCATOR
+  auto* block = ContainerBlock::fromHeader(container);
+  if (block->inTransferArena()) TransferArena::markReleased(block, arenaContainerSize(container));
+#endif
 #if USE_GC
   RuntimeAssert(container != nullptr, "Cannot destroy null container");
   container->setNextLink(state->finalizerQueue);
@@ -576,7 +1713,7 @@ inline void scheduleDestroyContainer(MemoryState* state, ContainerHeader* contai
 #else
   atomicAdd(&allocCount, -1);
   CONTAINER_DESTROY_EVENT(state, container)
-  konanFreeMemory(container);
+  freeContainerMemory(state, container);
 #endif
 }
 
@@ -585,34 +1722,143 @@ inline void scheduleDestroyContainer(MemoryState* state, ContainerHeader* contai
 template <bool Atomic>
 inline void IncrementRC(ContainerHeader* container) {
   container->incRefCount<Atomic>();
-  UPDATE_ADDREF_STAT(memoryState, container, Atomic);
+  ADDREF_EVENT(memoryState, container, Atomic)
+}
+
+template <bool Atomic, bool UseCycleCollector>
+inline void DecrementRC(ContainerHeader* container) {
+  if (container->decRefCount<Atomic>() == 0) {
+    FreeContainer(container);
+  }
+  RELEASEREF_EVENT(memoryState, container, Atomic, false)
+}
+
+#else // USE_GC
+
+inline uint32_t freeableSize(MemoryState* state) {
+  return state->toFree->size() - state->toFreeStart;
+}
+
+// If there are enough new release candidates, or enough memory was allocated since last collection.
+inline bool gcThresholdReached(MemoryState* state) {
+  auto size = freeableSize(state);
+  if (size >= state->gcThreshold + state->gcLeftover) return true;
+#if GC_ERGONOMICS
+  return size > 0 && state->gcAllocationThreshold != 0 && state->allocatedBytes >= state->gcAllocationThreshold;
+#else
+  return false;
+#endif
+}
+
+void garbageCollect(MemoryState* state, bool force);
+void garbageCollectWithin(MemoryState* state, uint64_t maxPauseMicros);
+bool hasRetiredRefs(MemoryState* state);
+void releaseRetiredRefs(MemoryState* state);
+
+#if USE_DEFERRED_STACK_RC
+
+void reconcileZeroCount(MemoryState* state);
+
+// Calls `process` for every normal container referenced from local variable slots of the current thread.
+template <typename func>
+inline void traverseStackReferredContainers(func process) {
+  for (auto* frame = currentFrame; frame != nullptr; frame = frame->previous) {
+    ObjHeader** slots = reinterpret_cast<ObjHeader**>(frame) + frame->count;
+    for (int index = 0; index < frame->stackCount; ++index) {
+      ObjHeader* obj = slots[index];
+      if (obj == nullptr) continue;
+      auto* container = obj->container();
+      if (container != nullptr && container->normal())
+        process(container);
+    }
+  }
+}
+
+inline void enqueueZeroCount(MemoryState* state, ContainerHeader* container) {
+  if (container->zeroCount()) return;
+  container->setZeroCount();
+  state->zeroCount->push_back(container);
+  if (state->gcSuspendCount == 0 && !state->gcInProgress && state->zeroCount->size() >= state->zeroCountThreshold)
+    reconcileZeroCount(state);
+}
+
+// Makes references from the stack counted.
+void incrementStack() {
+  traverseStackReferredContainers([](ContainerHeader* container) {
+    container->incRefCount</* Atomic = */ false>();
+  });
+}
+
+// Makes references from the stack not counted again. Containers frozen or shared meanwhile
+// keep references counted.
+void decrementStack(MemoryState* state) {
+  traverseStackReferredContainers([state](ContainerHeader* container) {
+    if (container->decRefCount</* Atomic = */ false>() == 0)
+      enqueueZeroCount(state, container);
+  });
+}
+
+// Frees containers with zero reference count, references from the stack must be counted.
+void freeZeroCount(MemoryState* state) {
+  auto& zeroCount = *state->zeroCount;
+  // Freeing containers can add new ones to the list.
+  while (!zeroCount.empty()) {
+    auto* container = zeroCount.back();
+    zeroCount.pop_back();
+    container->resetZeroCount();
+    if (container->refCount() == 0)
+      FreeContainer(container);
+  }
+}
+
+void reconcileZeroCount(MemoryState* state) {
+  state->gcSuspendCount++;
+  incrementStack();
+  freeZeroCount(state);
+  decrementStack(state);
+  state->gcSuspendCount--;
+  // Containers referenced from the stack remain, so wait for new ones before the next reconciliation.
+  state->zeroCountThreshold = std::max(kZeroCountThreshold, state->zeroCount->size() * 2);
 }
 
-template <bool Atomic, bool UseCycleCollector>
-inline void DecrementRC(ContainerHeader* container) {
-  if (container->decRefCount<Atomic>() == 0) {
-    FreeContainer(container);
+// Keeps references from the stack counted while in scope, so that reference counts are exact.
+class StackRefsCounted {
+ public:
+  explicit StackRefsCounted(MemoryState* state) : state_(state) {
+    state->gcSuspendCount++;
+    incrementStack();
+    freeZeroCount(state);
   }
-  UPDATE_RELEASEREF_STAT(memoryState, container, Atomic, false);
-}
 
-#else // USE_GC
+  ~StackRefsCounted() {
+    decrementStack(state_);
+    state_->gcSuspendCount--;
+  }
 
-inline uint32_t freeableSize(MemoryState* state) {
-  return state->toFree->size();
-}
+ private:
+  MemoryState* state_;
+};
+
+#endif  // USE_DEFERRED_STACK_RC
 
 template <bool Atomic>
 inline void IncrementRC(ContainerHeader* container) {
   container->incRefCount<Atomic>();
   container->setColorUnlessGreen(CONTAINER_TAG_GC_BLACK);
-  UPDATE_ADDREF_STAT(memoryState, container, Atomic);
+  ADDREF_EVENT(memoryState, container, Atomic)
 }
 
 template <bool Atomic, bool UseCycleCollector>
 inline void DecrementRC(ContainerHeader* container) {
   if (container->decRefCount<Atomic>() == 0) {
-    UPDATE_RELEASEREF_STAT(memoryState, container, Atomic, false);
+    RELEASEREF_EVENT(memoryState, container, Atomic, false)
+#if USE_DEFERRED_STACK_RC
+    // Could still be referenced from the stack, references to shared objects are always counted.
+    if (!Atomic) {
+      enqueueZeroCount(memoryState, container);
+      return;
+    }
+#endif
     FreeContainer(container);
   } else if (UseCycleCollector) { // Possible root.
     RuntimeAssert(!Atomic, "Cycle collector shalln't be used with shared objects yet");
@@ -623,19 +1869,20 @@ inline void DecrementRC(ContainerHeader* container) {
     // Also do not use cycle collector for provable acyclic objects.
     int color = container->color();
     if (color != CONTAINER_TAG_GC_PURPLE && color != CONTAINER_TAG_GC_GREEN) {
-      UPDATE_RELEASEREF_STAT(memoryState, container, Atomic, true);
+      RELEASEREF_EVENT(memoryState, container, Atomic, true)
       container->setColorAssertIfGreen(CONTAINER_TAG_GC_PURPLE);
       if (!container->buffered()) {
-        container->setBuffered();
         auto state = memoryState;
-        state->toFree->push_back(container);
-        if (state->gcSuspendCount == 0 && freeableSize(state) >= state->gcThreshold) {
-          GarbageCollect();
+        addCandidate(state, container);
+        if (state->gcSuspendCount == 0 && gcThresholdReached(state)) {
+          garbageCollect(state, false);
         }
       }
     } else {
-      UPDATE_RELEASEREF_STAT(memoryState, container, Atomic, false);
+      RELEASEREF_EVENT(memoryState, container, Atomic, false)
     }
+  } else {
+    RELEASEREF_EVENT(memoryState, container, Atomic, false)
   }
 }
 
@@ -643,8 +1890,190 @@ inline void initThreshold(MemoryState* state, uint32_t gcThreshold) {
   state->gcThreshold = gcThreshold;
   state->toFree->reserve(gcThreshold);
 }
+
+#if GC_ERGONOMICS
+// Adjusts GC threshold based on time spent in collection, pause history and heap growth.
+void updateGcPolicy(MemoryState* state, uint64_t gcStartTime, uint64_t gcEndTime) {
+  auto pause = gcEndTime - gcStartTime;
+  state->gcAveragePauseMicros = (state->gcAveragePauseMicros * 3 + pause) / 4;
+  state->allocatedBytes = 0;
+  int liveContainers = atomicGet(&allocCount);
+  bool heapGrows = state->lastLiveContainers != 0 && liveContainers > 2 * state->lastLiveContainers;
+  state->lastLiveContainers = liveContainers;
+  if (!state->gcAutotune) return;
+
+  auto gcToComputeRatio = double(pause) / (gcStartTime - state->lastGcTimestamp + 1);
+  size_t threshold = state->gcThreshold;
+  if (state->gcTargetPauseMicros != 0 && state->gcAveragePauseMicros > state->gcTargetPauseMicros) {
+    // Pauses are too long, collect fewer candidates at once.
+    threshold = std::max(kMinErgonomicThreshold, threshold * 2 / 3);
+  } else if (gcToComputeRatio > kGcToComputeRatioThreshold && !heapGrows) {
+    // Too much time is spent in collection, collect less often unless heap grows fast.
+    threshold = std::min(kMaxErgonomicThreshold, threshold * 3 / 2 + 1);
+  } else if (gcToComputeRatio < kGcToComputeRatioDecayThreshold && threshold > state->gcBaseThreshold) {
+    // Collection is cheap, get back to user's threshold to keep memory footprint low.
+    threshold = std::max(state->gcBaseThreshold, threshold * 3 / 4);
+  }
+  if (threshold != state->gcThreshold) {
+    MEMORY_LOG("Adjusting GC threshold to %d\n", threshold);
+    initThreshold(state, threshold);
+  }
+}
+#endif  // GC_ERGONOMICS
 #endif // USE_GC
 
+#if USE_BIASED_RC
+
+inline uint32_t biasOwnerId(uint32_t bias) {
+  return bias >> kBiasOwnerShift;
+}
+
+void initBiasOwner(MemoryState* state) {
+  if (atomicGet(&lastBiasOwnerId) >= kMaxBiasOwners - 1) return;
+  auto id = atomicAdd(&lastBiasOwnerId, 1u);
+  if (id >= kMaxBiasOwners) return;
+  auto* owner = konanConstructInstance<BiasOwner>();
+  atomicSet(&biasOwners[id], owner);
+  state->biasOwner = owner;
+  state->biasOwnerId = id;
+}
+
+// Stack containers have no container block to keep the local counter, so cannot be biased.
+// Note that they are no longer recognizable as such once frozen.
+inline void biasContainer(MemoryState* state, ContainerHeader* container) {
+  if (state->biasOwnerId == 0 || container->stack()) return;
+  // All references counted so far remain in the shared counter.
+  ContainerBlock::fromHeader(container)->bias_ = state->biasOwnerId << kBiasOwnerShift;
+  container->setBiased();
+}
+
+inline void IncrementBiasedRC(ContainerHeader* container) {
+  auto* block = ContainerBlock::fromHeader(container);
+  uint32_t bias = atomicGet(&block->bias_);
+  auto ownerId = memoryState->biasOwnerId;
+  if (ownerId != 0 && biasOwnerId(bias) == ownerId && (bias & kBiasLocalMask) != kBiasLocalMask) {
+    block->bias_ = bias + 1;
+    ADDREF_EVENT(memoryState, container, false)
+  } else {
+    IncrementRC</* Atomic = */ true>(container);
+  }
+}
+
+// Releases reference to the container biased to the current thread.
+void releaseOwnBiased(ContainerHeader* container) {
+  auto* block = ContainerBlock::fromHeader(container);
+  uint32_t bias = block->bias_;
+  if ((bias & kBiasLocalMask) != 0) {
+    block->bias_ = --bias;
+    if ((bias & kBiasLocalMask) != 0 || (atomicGet(&container->refCount_) >> CONTAINER_TAG_SHIFT) != 0)
+      return;
+  } else if (container->decRefCount</* Atomic = */ true>() != 0) {
+    return;
+  }
+  FreeContainer(container);
+}
+
+// Releases reference to the container biased to another thread.
+void releaseForeignBiased(ContainerHeader* container, uint32_t ownerId) {
+  // While shared counter keeps other references, this one could not be the last.
+  while (true) {
+    uint32_t value = atomicGet(&container->refCount_);
+    if ((value >> CONTAINER_TAG_SHIFT) < 2) break;
+    if (compareAndSet(&container->refCount_, value, value - CONTAINER_TAG_INCREMENT)) {
+      RELEASEREF_EVENT(memoryState, container, true, false)
+      return;
+    }
+  }
+  auto* owner = atomicGet(&biasOwners[ownerId]);
+  if (atomicGet(&owner->releases) != kDeadBiasOwner) {
+    auto* release = konanConstructInstance<BiasedRelease>();
+    release->container = container;
+    BiasedRelease* head;
+    do {
+      head = atomicGet(&owner->releases);
+      if (head == kDeadBiasOwner) break;
+      release->next = head;
+    } while (!compareAndSet(&owner->releases, head, release));
+    if (head != kDeadBiasOwner) {
+      RELEASEREF_EVENT(memoryState, container, true, false)
+      return;
+    }
+    konanDestructInstance(release);
+  }
+  // Owner is gone, so merge its local counter to the shared one, unless already done.
+  lock(&owner->lock);
+  auto* block = ContainerBlock::fromHeader(container);
+  uint32_t bias = atomicGet(&block->bias_);
+  if (biasOwnerId(bias) == ownerId) {
+    atomicAdd(&container->refCount_, (bias & kBiasLocalMask) << CONTAINER_TAG_SHIFT);
+    atomicSet(&block->bias_, 0u);
+  }
+  unlock(&owner->lock);
+  DecrementRC</* Atomic = */ true, /* UseCyclicCollector = */ false>(container);
+}
+
+inline void DecrementBiasedRC(ContainerHeader* container) {
+  auto ownerId = biasOwnerId(atomicGet(&ContainerBlock::fromHeader(container)->bias_));
+  if (ownerId == 0) {
+    DecrementRC</* Atomic = */ true, /* UseCyclicCollector = */ false>(container);
+  } else if (ownerId == memoryState->biasOwnerId) {
+    RELEASEREF_EVENT(memoryState, container, false, false)
+    releaseOwnBiased(container);
+  } else {
+    releaseForeignBiased(container, ownerId);
+  }
+}
+
+// Releases references handed over to the current thread by other threads.
+void processBiasedReleases(MemoryState* state) {
+  auto* owner = state->biasOwner;
+  if (owner == nullptr || atomicGet(&owner->releases) == nullptr) return;
+  auto* release = atomicExchange(&owner->releases, static_cast<BiasedRelease*>(nullptr));
+  while (release != nullptr) {
+    auto* next = release->next;
+    releaseOwnBiased(release->container);
+    konanDestructInstance(release);
+    release = next;
+  }
+}
+
+// Called on allocation, so that references handed over to a busy thread do not wait for its next collection.
+inline void biasedReleasesSafepoint(MemoryState* state) {
+  auto* owner = state->biasOwner;
+  if (owner == nullptr || atomicGet(&owner->releases) == nullptr) return;
+#if USE_GC
+  if (state->gcInProgress || state->gcSuspendCount > 0) return;
+#endif
+  processBiasedReleases(state);
+}
+
+void deinitBiasOwner(MemoryState* state) {
+  auto* owner = state->biasOwner;
+  if (owner == nullptr) return;
+  // Releasing handed over references could hand over more of them.
+  do {
+    processBiasedReleases(state);
+  } while (!compareAndSet(&owner->releases, static_cast<BiasedRelease*>(nullptr), kDeadBiasOwner));
+  state->biasOwner = nullptr;
+  state->biasOwnerId = 0;
+}
+
+#endif  // USE_BIASED_RC
+
+#if USE_CONTAINER_ALLOCATOR
+
+// Number of references to the container, including ones counted in the bias.
+inline uint32_t totalRefCount(const ContainerHeader* container) {
+  uint32_t result = container->refCount();
+#if USE_BIASED_RC
+  if (container->biased())
+    result += ContainerBlock::fromHeader(const_cast<ContainerHeader*>(container))->bias_ & kBiasLocalMask;
+#endif
+  return result;
+}
+
+#endif  // USE_CONTAINER_ALLOCATOR
+
 #if TRACE_MEMORY && USE_GC
 
 const char* colorNames[] = {"BLACK", "GRAY", "WHITE", "PURPLE", "GREEN", "ORANGE", "RED"};
@@ -714,13 +2143,13 @@ void Scan(ContainerHeader* container);
 
 template<bool useColor>
 void MarkGray(ContainerHeader* start) {
-  ContainerHeaderDeque toVisit;
-  toVisit.push_front(start);
+  auto& toVisit = *memoryState->markStack;
+  auto base = toVisit.size();
+  toVisit.push(start);
 
-  while (!toVisit.empty()) {
-    auto* container = toVisit.front();
+  while (toVisit.size() > base) {
+    auto* container = toVisit.pop();
     MEMORY_LOG("MarkGray visit %p [%s]\n", container, colorNames[container->color()]);
-    toVisit.pop_front();
     if (useColor) {
       int color = container->color();
       if (color == CONTAINER_TAG_GC_GRAY) continue;
@@ -735,12 +2164,12 @@ void MarkGray(ContainerHeader* start) {
       container->mark();
     }
 
-    traverseContainerReferredObjects(container, [&toVisit](ObjHeader* ref) {
+    traverseContainerReferredObjectsPrefetching(container, [&toVisit](ObjHeader* ref) {
       auto* childContainer = ref->container();
       RuntimeAssert(!isArena(childContainer), "A reference to local object is encountered");
       if (!Shareable(childContainer)) {
         childContainer->decRefCount<false>();
-        toVisit.push_front(childContainer);
+        toVisit.push(childContainer);
       }
     });
   }
@@ -748,12 +2177,12 @@ void MarkGray(ContainerHeader* start) {
 
 template<bool useColor>
 void ScanBlack(ContainerHeader* start) {
-  ContainerHeaderDeque toVisit;
-  toVisit.push_front(start);
-  while (!toVisit.empty()) {
-    auto* container = toVisit.front();
+  auto& toVisit = *memoryState->markStack;
+  auto base = toVisit.size();
+  toVisit.push(start);
+  while (toVisit.size() > base) {
+    auto* container = toVisit.pop();
     MEMORY_LOG("ScanBlack visit %p [%s]\n", container, colorNames[container->color()]);
-    toVisit.pop_front();
     if (useColor) {
       auto color = container->color();
       if (color == CONTAINER_TAG_GC_GREEN || color == CONTAINER_TAG_GC_BLACK) continue;
@@ -762,7 +2191,7 @@ void ScanBlack(ContainerHeader* start) {
       if (!container->marked()) continue;
       container->unMark();
     }
-    traverseContainerReferredObjects(container, [&toVisit](ObjHeader* ref) {
+    traverseContainerReferredObjectsPrefetching(container, [&toVisit](ObjHeader* ref) {
         auto childContainer = ref->container();
         RuntimeAssert(!isArena(childContainer), "A reference to local object is encountered");
         if (!Shareable(childContainer)) {
@@ -770,10 +2199,10 @@ void ScanBlack(ContainerHeader* start) {
           if (useColor) {
             int color = childContainer->color();
             if (color != CONTAINER_TAG_GC_BLACK)
-              toVisit.push_front(childContainer);
+              toVisit.push(childContainer);
           } else {
             if (childContainer->marked())
-              toVisit.push_front(childContainer);
+              toVisit.push(childContainer);
           }
         }
     });
@@ -782,16 +2211,22 @@ void ScanBlack(ContainerHeader* start) {
 
 void CollectWhite(MemoryState*, ContainerHeader* container);
 
-void CollectCycles(MemoryState* state) {
+// Collects cycles reachable from the first `count` unprocessed release candidates. Candidates added during
+// collection are kept.
+void CollectCycles(MemoryState* state, size_t count) {
+  state->gcSliceSize = count;
   MarkRoots(state);
   ScanRoots(state);
   CollectRoots(state);
-  state->toFree->clear();
+  state->toFreeStart += count;
+  compactCandidates(state);
   state->roots->clear();
 }
 
 void MarkRoots(MemoryState* state) {
-  for (auto container : *(state->toFree)) {
+  auto end = state->toFreeStart + state->gcSliceSize;
+  for (size_t index = state->toFreeStart; index < end; ++index) {
+    auto container = (*state->toFree)[index];
     if (isMarkedAsRemoved(container))
       continue;
     // Acyclic containers cannot be in this list.
@@ -821,44 +2256,69 @@ void CollectRoots(MemoryState* state) {
   // Here we might free some objects and call deallocation hooks on them,
   // which in turn might call DecrementRC and trigger new GC - forbid that.
   state->gcSuspendCount++;
+  // Containers still buffered after that are candidates outside of the collected slice.
   for (auto* container : *(state->roots)) {
     container->resetBuffered();
+  }
+  for (auto* container : *(state->roots)) {
     CollectWhite(state, container);
   }
   state->gcSuspendCount--;
 }
 
 void Scan(ContainerHeader* start) {
-  ContainerHeaderDeque toVisit;
-  toVisit.push_front(start);
+  auto& toVisit = *memoryState->markStack;
+  auto base = toVisit.size();
+  toVisit.push(start);
 
-  while (!toVisit.empty()) {
-     auto* container = toVisit.front();
-     toVisit.pop_front();
+  while (toVisit.size() > base) {
+     auto* container = toVisit.pop();
      if (container->color() != CONTAINER_TAG_GC_GRAY) continue;
      if (container->refCount() != 0) {
        ScanBlack<true>(container);
        continue;
      }
      container->setColorAssertIfGreen(CONTAINER_TAG_GC_WHITE);
-     traverseContainerReferredObjects(container, [&toVisit](ObjHeader* ref) {
+     traverseContainerReferredObjectsPrefetching(container, [&toVisit](ObjHeader* ref) {
        auto* childContainer = ref->container();
        RuntimeAssert(!isArena(childContainer), "A reference to local object is encountered");
        if (!Shareable(childContainer)) {
-         toVisit.push_front(childContainer);
+         toVisit.push(childContainer);
        }
      });
    }
 }
 
 void CollectWhite(MemoryState* state, ContainerHeader* start) {
-   ContainerHeaderDeque toVisit;
-   toVisit.push_back(start);
-
-   while (!toVisit.empty()) {
-     auto* container = toVisit.front();
-     toVisit.pop_front();
-     if (container->color() != CONTAINER_TAG_GC_WHITE || container->buffered()) continue;
+   auto& toVisit = *state->markStack;
+   auto base = toVisit.size();
+   toVisit.push(start);
+
+   while (toVisit.size() > base) {
+     auto* container = toVisit.pop();
+     if (container->color() != CONTAINER_TAG_GC_WHITE) continue;
+     if (container->buffered()) {
+       // Garbage which is still a candidate not yet processed by incremental collection, we cannot free it
+       // before it is removed from toFree. So just release its references, and let MarkRoots() destroy it
+       // once it sees black container with zero refcount.
+       if (container->refCount() == 0) {
+         container->setColorAssertIfGreen(CONTAINER_TAG_GC_BLACK);
+         traverseContainerObjectFields(container, [&toVisit](ObjHeader** location) {
+           auto* ref = *location;
+           if (ref == nullptr) return;
+           auto* childContainer = ref->container();
+           if (Shareable(childContainer)) {
+             UpdateRef(location, nullptr);
+           } else {
+             // Reference count was already accounted by MarkGray().
+             *location = nullptr;
+             toVisit.push(childContainer);
+           }
+         });
+         runDeallocationHooks(container);
+       }
+       continue;
+     }
      container->setColorAssertIfGreen(CONTAINER_TAG_GC_BLACK);
      traverseContainerObjectFields(container, [state, &toVisit](ObjHeader** location) {
         auto* ref = *location;
@@ -868,13 +2328,88 @@ void CollectWhite(MemoryState* state, ContainerHeader* start) {
         if (Shareable(childContainer)) {
           UpdateRef(location, nullptr);
         } else {
-          toVisit.push_front(childContainer);
+          toVisit.push(childContainer);
         }
      });
     runDeallocationHooks(container);
     scheduleDestroyContainer(state, container);
   }
 }
+
+// Collects garbage until either toFree is empty or, unless `force` is set, time budget is exceeded.
+void garbageCollect(MemoryState* state, bool force) {
+  garbageCollectWithin(state, force ? 0 : state->gcMaxPauseMicros);
+}
+
+// Collects garbage until either toFree is empty or `maxPauseMicros`, unless zero, is exceeded.
+void garbageCollectWithin(MemoryState* state, uint64_t maxPauseMicros) {
+  RuntimeAssert(!state->gcInProgress, "Recursive GC is disallowed");
+
+  MEMORY_LOG("Garbage collect\n")
+
+  auto gcStartTime = konan::getTimeMicros();
+
+  state->gcInProgress = true;
+
+#if USE_BIASED_RC
+  // Handed over references could be the last ones to frozen objects.
+  state->gcSuspendCount++;
+  processBiasedReleases(state);
+  state->gcSuspendCount--;
+#endif
+  // Same for retired references to values of shared locations, if no longer read.
+  state->gcSuspendCount++;
+  releaseRetiredRefs(state);
+  state->gcSuspendCount--;
+
+#if USE_DEFERRED_STACK_RC
+  // Cycle collection requires exact reference counts.
+  state->gcSuspendCount++;
+  incrementStack();
+  freeZeroCount(state);
+#endif
+
+  processFinalizerQueue(state);
+
+  if (maxPauseMicros == 0) {
+    while (freeableSize(state) > 0) {
+      CollectCycles(state, freeableSize(state));
+      processFinalizerQueue(state);
+#if USE_DEFERRED_STACK_RC
+      freeZeroCount(state);
+#endif
+    }
+  } else {
+    auto deadline = konan::getTimeMicros() + maxPauseMicros;
+    while (freeableSize(state) > 0) {
+      CollectCycles(state, std::min(static_cast<size_t>(freeableSize(state)), kGcSliceSize));
+      processFinalizerQueue(state);
+#if USE_DEFERRED_STACK_RC
+      freeZeroCount(state);
+#endif
+      if (konan::getTimeMicros() >= deadline) break;
+    }
+  }
+
+#if USE_DEFERRED_STACK_RC
+  decrementStack(state);
+  state->gcSuspendCount--;
+  state->zeroCountThreshold = std::max(kZeroCountThreshold, state->zeroCount->size() * 2);
+#endif
+  // Do not trigger collection again until enough new candidates are added.
+  state->gcLeftover = freeableSize(state);
+
+  state->gcInProgress = false;
+
+  auto gcEndTime = konan::getTimeMicros();
+  memoryCounters.incGc(gcEndTime - gcStartTime);
+#if GC_ERGONOMICS
+  updateGcPolicy(state, gcStartTime, gcEndTime);
+  MEMORY_LOG("Garbage collect: GC length=%lld sinceLast=%lld\n",
+             (gcEndTime - gcStartTime), gcStartTime - state->lastGcTimestamp);
+  state->lastGcTimestamp = gcEndTime;
+#endif
+}
 #endif
 
 inline void AddRef(ContainerHeader* header) {
@@ -886,6 +2421,14 @@ inline void AddRef(ContainerHeader* header) {
     case CONTAINER_TAG_NORMAL:
       IncrementRC</* Atomic = */ false>(header);
       break;
+#if USE_BIASED_RC
+    case CONTAINER_TAG_FROZEN:
+      if (header->biased())
+        IncrementBiasedRC(header);
+      else
+        IncrementRC</* Atomic = */ true>(header);
+      break;
+#endif
     /* case CONTAINER_TAG_FROZEN: case CONTAINER_TAG_ATOMIC: */
     default:
       IncrementRC</* Atomic = */ true>(header);
@@ -902,6 +2445,14 @@ inline void ReleaseRef(ContainerHeader* header) {
     case CONTAINER_TAG_NORMAL:
       DecrementRC</* Atomic = */ false, /* UseCyclicCollector = */ true>(header);
       break;
+#if USE_BIASED_RC
+    case CONTAINER_TAG_FROZEN:
+      if (header->biased())
+        DecrementBiasedRC(header);
+      else
+        DecrementRC</* Atomic = */ true, /* UseCyclicCollector = */ false>(header);
+      break;
+#endif
     /* case CONTAINER_TAG_FROZEN: case CONTAINER_TAG_ATOMIC: */
     default:
       DecrementRC</* Atomic = */ true, /* UseCyclicCollector = */ false>(header);
@@ -909,14 +2460,37 @@ inline void ReleaseRef(ContainerHeader* header) {
   }
 }
 
+inline ArenaContainer*& nextFrameArena(ArenaContainer* arena) {
+  return *reinterpret_cast<ArenaContainer**>(arena);
+}
+
+// Most frames never place objects to their arena, so it is only taken from the pool once needed.
+inline ArenaContainer* allocFrameArena(MemoryState* state) {
+  if (state == nullptr || state->frameArenas == nullptr)
+    return konanConstructInstance<ArenaContainer>();
+  auto* arena = state->frameArenas;
+  state->frameArenas = nextFrameArena(arena);
+  state->frameArenasCount--;
+  memset(arena, 0, sizeof(ArenaContainer));
+  return arena;
+}
+
+inline void freeFrameArena(MemoryState* state, ArenaContainer* arena) {
+  if (state == nullptr || state->frameArenasCount >= kArenaChunkPoolSize) {
+    konanFreeMemory(arena);
+    return;
+  }
+  nextFrameArena(arena) = state->frameArenas;
+  state->frameArenas = arena;
+  state->frameArenasCount++;
+}
+
 // We use first slot as place to store frame-local arena container.
-// TODO: create ArenaContainer object on the stack, so that we don't
-// do two allocations per frame (ArenaContainer + actual container).
 inline ArenaContainer* initedArena(ObjHeader** auxSlot) {
   auto frame = asFrameOverlay(auxSlot);
   auto arena = frame->arena;
   if (!arena) {
-    arena = konanConstructInstance<ArenaContainer>();
+    arena = allocFrameArena(memoryState);
     MEMORY_LOG("Initializing arena in %p\n", frame)
     arena->Init();
     frame->arena = arena;
@@ -973,14 +2547,19 @@ void ObjHeader::destroyMetaObject(TypeInfo** location) {
 
 ContainerHeader* AllocContainer(size_t size) {
   auto state = memoryState;
-#if USE_GC
-  // TODO: try to reuse elements of finalizer queue for new allocations, question
-  // is how to get actual size of container.
-#endif
+#if USE_CONTAINER_ALLOCATOR
+  ContainerHeader* result = state->transferArena != nullptr ?
+      state->transferArena->allocate(alignUp(size, kObjectAlignment)) :
+      state->allocator->allocate(alignUp(size, kObjectAlignment));
+#else
   ContainerHeader* result = konanConstructSizedInstance<ContainerHeader>(alignUp(size, kObjectAlignment));
+#endif
   CONTAINER_ALLOC_EVENT(state, size, result);
 #if TRACE_MEMORY
   state->containers->insert(result);
+#endif
+#if USE_GC && GC_ERGONOMICS
+  state->allocatedBytes += size;
 #endif
   atomicAdd(&allocCount, 1);
   return result;
@@ -1002,6 +2581,66 @@ ContainerHeader* AllocAggregatingFrozenContainer(KStdVector<ContainerHeader*>& c
   return superContainer;
 }
 
+#if USE_CONTAINER_ALLOCATOR
+// If container is released, but its memory is not yet, as it is a cycle candidate waiting for collection.
+inline bool isReleased(ContainerHeader* container) {
+  if (container->frozen() || container->refCount() != 0) return false;
+#if USE_DEFERRED_STACK_RC
+  // Otherwise it is referenced from the stack, as other containers with zero reference count are freed.
+  return !container->zeroCount();
+#else
+  return true;
+#endif
+}
+#endif  // USE_CONTAINER_ALLOCATOR
+
+bool VisitHeap(HeapVisitor* visitor) {
+#if USE_CONTAINER_ALLOCATOR
+  auto* state = memoryState;
+#if USE_DEFERRED_STACK_RC
+  {
+    // Free containers with zero reference count not referenced from the stack.
+    StackRefsCounted stackRefs(state);
+  }
+#endif
+#if USE_GC
+  // Objects of containers queued for destruction are overwritten with the queue links.
+  processFinalizerQueue(state);
+#endif
+  auto visit = [visitor](ContainerHeader* container, uint32_t size) {
+    if (isReleased(container)) return;
+    // Objects of aggregating container are kept in subcontainers, which are reported on their own.
+    if (isAggregatingFrozenContainer(container)) {
+      visitor->visitContainer(container, totalRefCount(container));
+      return;
+    }
+    // Containers other than arenas hold a single object.
+    auto* obj = reinterpret_cast<ObjHeader*>(container + 1);
+    auto objSize = objectSize(obj);
+    if (size != 0 && sizeof(ContainerHeader) + objSize > size) return;
+    auto* owner = obj->container();
+    if (owner == container)
+      visitor->visitContainer(container, totalRefCount(container));
+    visitor->visitObject(obj, owner, objSize);
+  };
+  state->allocator->forEachLive(visit);
+  TransferArena::forEachOwnedLive(state, visit);
+#if USE_DEFERRED_STACK_RC
+  for (auto* frame = currentFrame; frame != nullptr; frame = frame->previous) {
+    ObjHeader** slots = reinterpret_cast<ObjHeader**>(frame) + frame->count;
+    for (int index = 0; index < frame->stackCount; ++index) {
+      ObjHeader* obj = slots[index];
+      if (obj != nullptr && isFreeable(obj->container()))
+        visitor->visitStackRoot(obj);
+    }
+  }
+#endif  // USE_DEFERRED_STACK_RC
+  return true;
+#else
+  return false;
+#endif  // USE_CONTAINER_ALLOCATOR
+}
+
 void FreeAggregatingFrozenContainer(ContainerHeader* container) {
   auto* state = memoryState;
   RuntimeAssert(isAggregatingFrozenContainer(container), "expected fictitious frozen container");
@@ -1084,14 +2723,13 @@ void ArrayContainer::Init(const TypeInfo* typeInfo, uint32_t elements) {
   }
 }
 
-// TODO: store arena containers in some reuseable data structure, similar to
-// finalizer queue.
 void ArenaContainer::Init() {
-  allocContainer(1024);
+  allocContainer(kArenaChunkCapacity);
 }
 
 void ArenaContainer::Deinit() {
   MEMORY_LOG("Arena::Deinit start: %p\n", this)
+  ARENA_WASTE_STAT(memoryState, end_ - current_)
   auto chunk = currentChunk_;
   while (chunk != nullptr) {
     // FreeContainer() doesn't release memory when CONTAINER_TAG_STACK is set.
@@ -1100,43 +2738,95 @@ void ArenaContainer::Deinit() {
     chunk = chunk->next;
   }
   chunk = currentChunk_;
+  // Only the current chunk is partially used.
+  uint8_t* used = current_;
   while (chunk != nullptr) {
     auto toRemove = chunk;
     chunk = chunk->next;
-    konanFreeMemory(toRemove);
+    releaseChunk(toRemove, used);
+    used = nullptr;
   }
+  currentChunk_ = nullptr;
+  chunkCapacity_ = 0;
 }
 
-bool ArenaContainer::allocContainer(container_size_t minSize) {
-  auto size = minSize + sizeof(ContainerHeader) + sizeof(ContainerChunk);
-  size = alignUp(size, kContainerAlignment);
-  // TODO: keep simple cache of container chunks.
-  ContainerChunk* result = konanConstructSizedInstance<ContainerChunk>(size);
+void ArenaContainer::releaseChunk(ContainerChunk* chunk, uint8_t* used) {
+  auto state = memoryState;
+  if (state == nullptr || chunk->size != arenaChunkSize(kArenaChunkCapacity) ||
+      state->arenaChunksCount >= kArenaChunkPoolSize) {
+    konanFreeMemory(chunk);
+    return;
+  }
+  uint8_t* end = used != nullptr ? used : reinterpret_cast<uint8_t*>(chunk) + chunk->size;
+  memset(chunk, 0, end - reinterpret_cast<uint8_t*>(chunk));
+  chunk->next = state->arenaChunks;
+  state->arenaChunks = chunk;
+  state->arenaChunksCount++;
+}
+
+ContainerChunk* ArenaContainer::allocChunk(container_size_t capacity) {
+  auto size = arenaChunkSize(capacity);
+  ContainerChunk* result = nullptr;
+  auto state = memoryState;
+  if (state != nullptr && state->arenaChunks != nullptr && size == arenaChunkSize(kArenaChunkCapacity)) {
+    result = state->arenaChunks;
+    state->arenaChunks = result->next;
+    state->arenaChunksCount--;
+  } else {
+    result = konanConstructSizedInstance<ContainerChunk>(size);
+  }
   RuntimeAssert(result != nullptr, "Cannot alloc memory");
-  if (result == nullptr) return false;
-  result->next = currentChunk_;
+  if (result == nullptr) return nullptr;
   result->arena = this;
+  result->size = size;
   result->asHeader()->refCount_ = (CONTAINER_TAG_STACK | CONTAINER_TAG_INCREMENT);
+  return result;
+}
+
+bool ArenaContainer::allocContainer(container_size_t minSize) {
+  // Chunks grow geometrically, so that arenas holding many objects need only few of them.
+  chunkCapacity_ = chunkCapacity_ == 0 ? kArenaChunkCapacity : std::min(chunkCapacity_ * 2, kArenaMaxChunkCapacity);
+  auto result = allocChunk(std::max(minSize, chunkCapacity_));
+  if (result == nullptr) return false;
+  ARENA_CHUNK_STAT(memoryState, result->size, false)
+  if (currentChunk_ != nullptr) {
+    ARENA_WASTE_STAT(memoryState, end_ - current_)
+  }
+  result->next = currentChunk_;
   currentChunk_ = result;
   current_ = reinterpret_cast<uint8_t*>(result->asHeader() + 1);
-  end_ = reinterpret_cast<uint8_t*>(result) + size;
+  end_ = reinterpret_cast<uint8_t*>(result) + result->size;
   return true;
 }
 
-void* ArenaContainer::place(container_size_t size) {
+void* ArenaContainer::place(container_size_t size, ContainerHeader** container) {
   size = alignUp(size, kObjectAlignment);
   // Fast path.
   if (current_ + size < end_) {
     void* result = current_;
     current_ += size;
+    *container = currentChunk_->asHeader();
     return result;
   }
+  if (size >= kArenaLargeObjectSize) {
+    // Large objects get chunks of their own, so that the rest of the current chunk is not wasted.
+    auto chunk = allocChunk(size);
+    if (chunk == nullptr) return nullptr;
+    ARENA_CHUNK_STAT(memoryState, chunk->size, true)
+    ARENA_WASTE_STAT(memoryState, chunk->size - size - sizeof(ContainerHeader) - sizeof(ContainerChunk))
+    // Keep the current chunk first, as only it is partially used.
+    chunk->next = currentChunk_->next;
+    currentChunk_->next = chunk;
+    *container = chunk->asHeader();
+    return chunk->asHeader() + 1;
+  }
   if (!allocContainer(size)) {
     return nullptr;
   }
   void* result = current_;
   current_ += size;
   RuntimeAssert(current_ <= end_, "Must not overflow");
+  *container = currentChunk_->asHeader();
   return result;
 }
 
@@ -1153,26 +2843,28 @@ ObjHeader** ArenaContainer::getSlot() {
 ObjHeader* ArenaContainer::PlaceObject(const TypeInfo* type_info) {
   RuntimeAssert(type_info->instanceSize_ >= 0, "must be an object");
   uint32_t size = type_info->instanceSize_;
-  ObjHeader* result = reinterpret_cast<ObjHeader*>(place(size));
+  ContainerHeader* container = nullptr;
+  ObjHeader* result = reinterpret_cast<ObjHeader*>(place(size, &container));
   if (!result) {
     return nullptr;
   }
   OBJECT_ALLOC_EVENT(memoryState, type_info->instanceSize_, result)
-  currentChunk_->asHeader()->incObjectCount();
-  setHeader(result, type_info);
+  container->incObjectCount();
+  setHeader(result, type_info, container);
   return result;
 }
 
 ArrayHeader* ArenaContainer::PlaceArray(const TypeInfo* type_info, uint32_t count) {
   RuntimeAssert(type_info->instanceSize_ < 0, "must be an array");
   container_size_t size = arrayObjectSize(type_info, count);
-  ArrayHeader* result = reinterpret_cast<ArrayHeader*>(place(size));
+  ContainerHeader* container = nullptr;
+  ArrayHeader* result = reinterpret_cast<ArrayHeader*>(place(size, &container));
   if (!result) {
     return nullptr;
   }
   OBJECT_ALLOC_EVENT(memoryState, arrayObjectSize(type_info, count), result->obj())
-  currentChunk_->asHeader()->incObjectCount();
-  setHeader(result->obj(), type_info);
+  container->incObjectCount();
+  setHeader(result->obj(), type_info, container);
   result->count_ = count;
   return result;
 }
@@ -1193,6 +2885,90 @@ inline void ReleaseRef(const ObjHeader* object) {
   }
 }
 
+// Adds `count` references to the container at once.
+inline void addRefs(ContainerHeader* header, unsigned count) {
+  switch (header->tag()) {
+    case CONTAINER_TAG_STACK:
+      break;
+    case CONTAINER_TAG_NORMAL:
+      header->incRefCount</* Atomic = */ false>(count - 1);
+      IncrementRC</* Atomic = */ false>(header);
+      break;
+#if USE_BIASED_RC
+    case CONTAINER_TAG_FROZEN:
+      if (header->biased()) {
+        while (count-- > 0) IncrementBiasedRC(header);
+        break;
+      }
+      // Fall through.
+#endif
+    /* case CONTAINER_TAG_FROZEN: case CONTAINER_TAG_ATOMIC: */
+    default:
+      header->incRefCount</* Atomic = */ true>(count - 1);
+      IncrementRC</* Atomic = */ true>(header);
+      break;
+  }
+}
+
+// Releases `count` references to the container at once. Only the last release may free the container,
+// as all released references were counted.
+inline void releaseRefs(ContainerHeader* header, unsigned count) {
+  switch (header->tag()) {
+    case CONTAINER_TAG_STACK:
+      break;
+    case CONTAINER_TAG_NORMAL:
+      header->decRefCount</* Atomic = */ false>(count - 1);
+      DecrementRC</* Atomic = */ false, /* UseCyclicCollector = */ true>(header);
+      break;
+#if USE_BIASED_RC
+    case CONTAINER_TAG_FROZEN:
+      if (header->biased()) {
+        while (count-- > 0) DecrementBiasedRC(header);
+        break;
+      }
+      // Fall through.
+#endif
+    /* case CONTAINER_TAG_FROZEN: case CONTAINER_TAG_ATOMIC: */
+    default:
+      header->decRefCount</* Atomic = */ true>(count - 1);
+      DecrementRC</* Atomic = */ true, /* UseCyclicCollector = */ false>(header);
+      break;
+  }
+}
+
+// Accumulates reference count updates of consecutive references to the same container,
+// so that runs of equal or neighbouring objects cost a single update.
+template <bool Release>
+class CoalescedRefs {
+ public:
+  ~CoalescedRefs() {
+    flush();
+  }
+
+  void add(const ObjHeader* object) {
+    auto* container = object->container();
+    if (container == nullptr || container->stack()) return;
+    if (container != container_) {
+      flush();
+      container_ = container;
+    }
+    count_++;
+  }
+
+  void flush() {
+    if (count_ == 0) return;
+    if (Release)
+      releaseRefs(container_, count_);
+    else
+      addRefs(container_, count_);
+    count_ = 0;
+  }
+
+ private:
+  ContainerHeader* container_ = nullptr;
+  unsigned count_ = 0;
+};
+
 void AddRefFromAssociatedObject(const ObjHeader* object) {
   AddRef(object);
 }
@@ -1201,6 +2977,112 @@ void ReleaseRefFromAssociatedObject(const ObjHeader* object) {
   ReleaseRef(object);
 }
 
+/**
+ * Hazard pointers let readers of shared locations, updated under a lock by writers, go without the lock.
+ * Before adding a reference to the value read from the location, the reader announces it in the hazard
+ * record of its thread, and then checks that the location still holds it. Writers removing a reference
+ * from the location retire it instead of releasing: it is released once no reader announces the value.
+ * As readers announce values just for a few instructions, retired references are rarely kept for long.
+ */
+struct HazardRecord {
+  HazardRecord* next;
+  // Value being read by the owner thread.
+  ObjHeader* volatile hazard;
+  // If record is owned by some thread.
+  volatile int32_t active;
+  // References retired by the owner thread, which were announced by some reader at the moment.
+  KStdVector<ObjHeader*> retired;
+};
+
+namespace {
+
+// Limit of spin pauses between attempts to release references retired by a finishing thread.
+constexpr int kMaxHazardBackoffPauses = 1024;
+
+// All hazard records ever created, records of finished threads are reused but never freed.
+HazardRecord* volatile hazardRecords = nullptr;
+
+HazardRecord* hazardRecord(MemoryState* state) {
+  auto* record = state->hazardRecord;
+  if (record != nullptr) return record;
+  for (record = atomicGet(&hazardRecords); record != nullptr; record = record->next) {
+    if (atomicGet(&record->active) == 0 && compareAndSwap(&record->active, 0, 1) == 0) break;
+  }
+  if (record == nullptr) {
+    record = konanConstructInstance<HazardRecord>();
+    record->active = 1;
+    HazardRecord* head;
+    do {
+      head = atomicGet(&hazardRecords);
+      record->next = head;
+    } while (compareAndSwap(&hazardRecords, head, record) != head);
+  }
+  state->hazardRecord = record;
+  return record;
+}
+
+inline bool isHazard(ObjHeader* object) {
+  for (auto* record = atomicGet(&hazardRecords); record != nullptr; record = record->next) {
+    if (atomicGet(&record->hazard) == object) return true;
+  }
+  return false;
+}
+
+// Releases retired references, which are not announced by readers anymore.
+void releaseRetired(HazardRecord* record) {
+  KStdVector<ObjHeader*> retired;
+  retired.swap(record->retired);
+  for (auto* object : retired) {
+    if (isHazard(object))
+      record->retired.push_back(object);
+    else
+      ReleaseRef(object);
+  }
+}
+
+// Releases reference removed from a shared location, once no reader announces it.
+void retireRef(MemoryState* state, ObjHeader* object) {
+  if (object == nullptr) return;
+  if (!isRefCounted(object)) {
+    ReleaseRef(object);
+    return;
+  }
+  auto* record = hazardRecord(state);
+  if (!record->retired.empty()) releaseRetired(record);
+  if (isHazard(object))
+    record->retired.push_back(object);
+  else
+    ReleaseRef(object);
+}
+
+void deinitHazardRecord(MemoryState* state) {
+  auto* record = state->hazardRecord;
+  // Readers announce values only for a moment, so just wait for them, backing off not to slow them down.
+  for (int pauses = 1; !record->retired.empty(); pauses = std::min(pauses * 2, kMaxHazardBackoffPauses)) {
+    for (int index = 0; index < pauses; ++index) spinPause();
+    releaseRetired(record);
+  }
+  state->hazardRecord = nullptr;
+  atomicSet(&record->active, 0);
+}
+
+// Same as SetRef(), but location could be concurrently read with ReadRefLockFree().
+inline void setRefShared(ObjHeader** location, ObjHeader* object) {
+  if (object != nullptr)
+    AddRef(object);
+  atomicSet(location, object);
+}
+
+bool hasRetiredRefs(MemoryState* state) {
+  return state->hazardRecord != nullptr && !state->hazardRecord->retired.empty();
+}
+
+void releaseRetiredRefs(MemoryState* state) {
+  if (hasRetiredRefs(state)) releaseRetired(state->hazardRecord);
+}
+
+}  // namespace
+
 extern "C" {
 
 MemoryState* InitMemory() {
@@ -1215,12 +3097,32 @@ MemoryState* InitMemory() {
   RuntimeAssert(sizeof(FrameOverlay) % sizeof(ObjHeader**) == 0, "Frame overlay should contain only pointers")
   RuntimeAssert(memoryState == nullptr, "memory state must be clear");
   memoryState = konanConstructInstance<MemoryState>();
+  memset(&memoryCounters, 0, sizeof(memoryCounters));
   INIT_EVENT(memoryState)
+  memoryState->markStack = konanConstructInstance<MarkStack>();
+#if USE_CONTAINER_ALLOCATOR
+  memoryState->allocator = konanConstructInstance<ContainerAllocator>();
+#endif
+#if USE_BIASED_RC
+  initBiasOwner(memoryState);
+#endif
 #if USE_GC
   memoryState->toFree = konanConstructInstance<ContainerHeaderList>();
   memoryState->roots = konanConstructInstance<ContainerHeaderList>();
   memoryState->gcInProgress = false;
+  memoryState->lastIdleGcTimestamp = 0;
+  memoryState->toFreeStart = 0;
+  memoryState->gcLeftover = 0;
   initThreshold(memoryState, kGcThreshold);
+  memoryState->gcMaxPauseMicros = 0;
+#if GC_ERGONOMICS
+  memoryState->gcAutotune = true;
+  memoryState->gcBaseThreshold = kGcThreshold;
+#endif
+#if USE_DEFERRED_STACK_RC
+  memoryState->zeroCount = konanConstructInstance<ContainerHeaderList>();
+  memoryState->zeroCountThreshold = kZeroCountThreshold;
+#endif
   memoryState->gcSuspendCount = 0;
 #endif
   atomicAdd(&aliveMemoryStatesCount, 1);
@@ -1228,17 +3130,34 @@ MemoryState* InitMemory() {
 }
 
 void DeinitMemory(MemoryState* memoryState) {
+  if (memoryState->hazardRecord != nullptr)
+    deinitHazardRecord(memoryState);
+#if USE_BIASED_RC
+  // Release handed over references and let other threads merge local counts of the remaining containers.
+  deinitBiasOwner(memoryState);
+#endif
 #if USE_GC
   GarbageCollect();
   RuntimeAssert(memoryState->toFree->size() == 0, "Some memory have not been released after GC");
   konanDestructInstance(memoryState->toFree);
   konanDestructInstance(memoryState->roots);
+#if USE_DEFERRED_STACK_RC
+  RuntimeAssert(memoryState->zeroCount->size() == 0, "Some memory have not been released after GC");
+  konanDestructInstance(memoryState->zeroCount);
+#endif
 
   RuntimeAssert(memoryState->finalizerQueue == nullptr, "Finalizer queue must be empty");
   RuntimeAssert(memoryState->finalizerQueueSize == 0, "Finalizer queue must be empty");
 
 #endif // USE_GC
 
+#if USE_CONTAINER_ALLOCATOR
+  TransferArena::disown(memoryState);
+  // Containers still referenced from other threads will be released to the orphaned allocator.
+  memoryState->allocator->orphan();
+  memoryState->allocator = nullptr;
+#endif
+
   bool lastMemoryState = atomicAdd(&aliveMemoryStatesCount, -1) == 0;
 
 #if TRACE_MEMORY
@@ -1256,6 +3175,18 @@ void DeinitMemory(MemoryState* memoryState) {
   PRINT_EVENT(memoryState)
   DEINIT_EVENT(memoryState)
 
+  konanDestructInstance(memoryState->markStack);
+  while (memoryState->arenaChunks != nullptr) {
+    auto* chunk = memoryState->arenaChunks;
+    memoryState->arenaChunks = chunk->next;
+    konanFreeMemory(chunk);
+  }
+  while (memoryState->frameArenas != nullptr) {
+    auto* arena = memoryState->frameArenas;
+    memoryState->frameArenas = nextFrameArena(arena);
+    konanFreeMemory(arena);
+  }
+
   konanFreeMemory(memoryState);
   ::memoryState = nullptr;
 }
@@ -1273,6 +3204,10 @@ void ResumeMemory(MemoryState* state) {
 
 OBJ_GETTER(AllocInstance, const TypeInfo* type_info) {
   RuntimeAssert(type_info->instanceSize_ >= 0, "must be an object");
+  ProfileObjectAllocation(type_info);
+#if USE_BIASED_RC
+  biasedReleasesSafepoint(memoryState);
+#endif
   if (isArenaSlot(OBJ_RESULT)) {
     auto arena = initedArena(asArenaSlot(OBJ_RESULT));
     auto result = arena->PlaceObject(type_info);
@@ -1284,6 +3219,10 @@ OBJ_GETTER(AllocInstance, const TypeInfo* type_info) {
 
 OBJ_GETTER(AllocArrayInstance, const TypeInfo* type_info, uint32_t elements) {
   RuntimeAssert(type_info->instanceSize_ < 0, "must be an array");
+  ProfileArrayAllocation(type_info, elements);
+#if USE_BIASED_RC
+  biasedReleasesSafepoint(memoryState);
+#endif
   if (isArenaSlot(OBJ_RESULT)) {
     auto arena = initedArena(asArenaSlot(OBJ_RESULT));
     auto result = arena->PlaceArray(type_info, elements)->obj();
@@ -1420,6 +3359,42 @@ void UpdateRef(ObjHeader** location, const ObjHeader* object) {
   }
 }
 
+#if USE_DEFERRED_STACK_RC
+// References from local variable slots are only counted for shareable objects, which could be released
+// by other threads.
+inline bool isStackRefCounted(const ObjHeader* object) {
+  auto* container = object->container();
+  return container != nullptr && container->shareable();
+}
+
+inline void releaseStackRefs(ObjHeader** start, int count) {
+  for (int index = 0; index < count; ++index) {
+    ObjHeader* object = start[index];
+    if (object != nullptr && isStackRefCounted(object))
+      ReleaseRef(object);
+  }
+}
+#endif
+
+void UpdateStackRef(ObjHeader** location, const ObjHeader* object) {
+#if USE_DEFERRED_STACK_RC
+  RuntimeAssert(!isArenaSlot(location), "must not be a slot");
+  ObjHeader* old = *location;
+  UPDATE_REF_EVENT(memoryState, old, object, location)
+  if (old != object) {
+    if (object != nullptr && isStackRefCounted(object)) {
+      AddRef(object);
+    }
+    *const_cast<const ObjHeader**>(location) = object;
+    if (old != nullptr && isStackRefCounted(old)) {
+      ReleaseRef(old);
+    }
+  }
+#else
+  UpdateRef(location, object);
+#endif
+}
+
 inline ObjHeader** slotAddressFor(ObjHeader** returnSlot, const ObjHeader* value) {
     if (!isArenaSlot(returnSlot)) return returnSlot;
     // Not a subject of reference counting.
@@ -1462,18 +3437,37 @@ void UpdateRefIfNull(ObjHeader** location, const ObjHeader* object) {
   }
 }
 
-void EnterFrame(ObjHeader** start, int parameters, int count) {
-  MEMORY_LOG("EnterFrame %p .. %p\n", start, start + count + parameters)
+void EnterFrame(ObjHeader** start, int parameters, int count, int stackCount) {
+  MEMORY_LOG("EnterFrame %p .. %p\n", start, start + count + stackCount)
+#if USE_DEFERRED_STACK_RC
+  if (stackCount > 0) {
+    auto* frame = asFrameOverlay(start);
+    frame->previous = currentFrame;
+    frame->count = count;
+    frame->stackCount = stackCount;
+    currentFrame = frame;
+  }
+#endif
 }
 
-void LeaveFrame(ObjHeader** start, int parameters, int count) {
-  MEMORY_LOG("LeaveFrame %p .. %p\n", start, start + count + parameters)
+void LeaveFrame(ObjHeader** start, int parameters, int count, int stackCount) {
+  MEMORY_LOG("LeaveFrame %p .. %p\n", start, start + count + stackCount)
+#if USE_DEFERRED_STACK_RC
+  if (stackCount > 0) {
+    auto* frame = asFrameOverlay(start);
+    RuntimeAssert(currentFrame == frame, "Frames must be left in reverse order");
+    currentFrame = frame->previous;
+    releaseStackRefs(start + count, stackCount);
+  }
+#else
+  ReleaseRefs(start + count, stackCount);
+#endif
   ReleaseRefs(start + parameters + kFrameOverlaySlots, count - kFrameOverlaySlots - parameters);
   if (*start != nullptr) {
     auto arena = initedArena(start);
     MEMORY_LOG("LeaveFrame: free arena %p\n", arena)
     arena->Deinit();
-    konanFreeMemory(arena);
+    freeFrameArena(memoryState, arena);
     MEMORY_LOG("LeaveFrame: free arena done %p\n", arena)
   }
 }
@@ -1493,47 +3487,86 @@ void ReleaseRefs(ObjHeader** start, int count) {
   }
 }
 
+void UpdateRefRange(ObjHeader** destination, ObjHeader* const* source, int count) {
+  if (destination == source || count <= 0) return;
+  MEMORY_LOG("UpdateRefRange %p .. %p <- %p\n", destination, destination + count, source)
+  // Count all new references first, so that objects present in both ranges never drop to zero.
+  {
+    CoalescedRefs</* Release = */ false> added;
+    for (int index = 0; index < count; ++index) {
+      ObjHeader* object = source[index];
+      if (object != nullptr && object != destination[index]) added.add(object);
+    }
+  }
+  CoalescedRefs</* Release = */ true> released;
+  auto copy = [&](int index) {
+    ObjHeader* old = destination[index];
+    ObjHeader* object = source[index];
+    UPDATE_REF_EVENT(memoryState, old, object, destination + index)
+    if (old == object) return;
+    destination[index] = object;
+    if (reinterpret_cast<uintptr_t>(old) > 1) released.add(old);
+  };
+  if (destination < source) {
+    for (int index = 0; index < count; ++index) copy(index);
+  } else {
+    for (int index = count - 1; index >= 0; --index) copy(index);
+  }
+}
+
+void FillRefRange(ObjHeader** destination, const ObjHeader* object, int count) {
+  MEMORY_LOG("FillRefRange %p .. %p <- %p\n", destination, destination + count, object)
+  if (object != nullptr) {
+    unsigned added = 0;
+    for (int index = 0; index < count; ++index) {
+      if (destination[index] != object) added++;
+    }
+    auto* container = object->container();
+    if (added != 0 && container != nullptr)
+      addRefs(container, added);
+  }
+  CoalescedRefs</* Release = */ true> released;
+  for (int index = 0; index < count; ++index) {
+    ObjHeader* old = destination[index];
+    UPDATE_REF_EVENT(memoryState, old, object, destination + index)
+    if (old == object) continue;
+    *const_cast<const ObjHeader**>(destination + index) = object;
+    if (reinterpret_cast<uintptr_t>(old) > 1) released.add(old);
+  }
+}
+
 #if USE_GC
 
 void GarbageCollect() {
-  MemoryState* state = memoryState;
-  RuntimeAssert(!state->gcInProgress, "Recursive GC is disallowed");
+  garbageCollect(memoryState, true);
+}
 
-  MEMORY_LOG("Garbage collect\n")
+#endif // USE_GC
 
-#if GC_ERGONOMICS
-  auto gcStartTime = konan::getTimeMicros();
+void GarbageCollectIdle() {
+#if USE_GC
+  MemoryState* state = memoryState;
+  if (state == nullptr || state->toFree == nullptr || state->gcInProgress || state->gcSuspendCount > 0)
+    return;
+  if (freeableSize(state) == 0 && state->finalizerQueue == nullptr
+#if USE_DEFERRED_STACK_RC
+      && state->zeroCount->size() == 0
 #endif
-
-  state->gcInProgress = true;
-
-  processFinalizerQueue(state);
-
-  while (state->toFree->size() > 0) {
-    CollectCycles(state);
-    processFinalizerQueue(state);
-  }
-
-  state->gcInProgress = false;
-
-#if GC_ERGONOMICS
-  auto gcEndTime = konan::getTimeMicros();
-  auto gcToComputeRatio = double(gcEndTime - gcStartTime) / (gcStartTime - state->lastGcTimestamp + 1);
-  if (gcToComputeRatio > kGcToComputeRatioThreshold) {
-     auto newThreshold = state->gcThreshold * 3 / 2 + 1;
-     if (newThreshold < kMaxErgonomicThreshold) {
-        MEMORY_LOG("Adjusting GC threshold to %d\n", newThreshold);
-        initThreshold(state, newThreshold);
-     }
-  }
-  MEMORY_LOG("Garbage collect: GC length=%lld sinceLast=%lld\n",
-             (gcEndTime - gcStartTime), gcStartTime - state->lastGcTimestamp);
-  state->lastGcTimestamp = gcEndTime;
+#if USE_BIASED_RC
+      && (state->biasOwner == nullptr || atomicGet(&state->biasOwner->releases) == nullptr)
+#endif
+      && !hasRetiredRefs(state))
+    return;
+  // Idle periods may be very short and frequent, so below the threshold collect at most once per interval.
+  auto now = konan::getTimeMicros();
+  if (!gcThresholdReached(state) && now - state->lastIdleGcTimestamp < kIdleGcIntervalMicros)
+    return;
+  state->lastIdleGcTimestamp = now;
+  auto budget = state->gcMaxPauseMicros;
+  garbageCollectWithin(state, budget == 0 || budget > kIdleGcBudgetMicros ? kIdleGcBudgetMicros : budget);
 #endif
 }
 
-#endif // USE_GC
-
 void Kotlin_native_internal_GC_collect(KRef) {
 #if USE_GC
   GarbageCollect();
@@ -1551,9 +3584,8 @@ void Kotlin_native_internal_GC_resume(KRef) {
   MemoryState* state = memoryState;
   if (state->gcSuspendCount > 0) {
     state->gcSuspendCount--;
-    if (state->toFree != nullptr &&
-        freeableSize(state) >= state->gcThreshold) {
-      GarbageCollect();
+    if (state->toFree != nullptr && gcThresholdReached(state)) {
+      garbageCollect(state, false);
     }
   }
 #endif
@@ -1584,6 +3616,9 @@ void Kotlin_native_internal_GC_setThreshold(KRef, KInt value) {
 #if USE_GC
   if (value > 0) {
     initThreshold(memoryState, value);
+#if GC_ERGONOMICS
+    memoryState->gcBaseThreshold = value;
+#endif
   }
 #endif
 }
@@ -1596,6 +3631,74 @@ KInt Kotlin_native_internal_GC_getThreshold(KRef) {
 #endif
 }
 
+void Kotlin_native_internal_GC_setMaxPauseMicros(KRef, KLong value) {
+#if USE_GC
+  if (value >= 0) {
+    memoryState->gcMaxPauseMicros = value;
+  }
+#endif
+}
+
+KLong Kotlin_native_internal_GC_getMaxPauseMicros(KRef) {
+#if USE_GC
+  return memoryState->gcMaxPauseMicros;
+#else
+  return -1;
+#endif
+}
+
+void Kotlin_native_internal_GC_getStatistics(KRef, KRef counters) {
+  ArrayHeader* array = counters->array();
+  RuntimeAssert(array->count_ * sizeof(KLong) == sizeof(MemoryCounters), "Unexpected statistics size");
+  memcpy(PrimitiveArrayAddressOfElementAt<KLong>(array, 0), &memoryCounters, sizeof(MemoryCounters));
+}
+
+void Kotlin_native_internal_GC_setAutotune(KRef, KBoolean value) {
+#if USE_GC && GC_ERGONOMICS
+  memoryState->gcAutotune = value;
+#endif
+}
+
+KBoolean Kotlin_native_internal_GC_getAutotune(KRef) {
+#if USE_GC && GC_ERGONOMICS
+  return memoryState->gcAutotune;
+#else
+  return false;
+#endif
+}
+
+void Kotlin_native_internal_GC_setTargetPauseMicros(KRef, KLong value) {
+#if USE_GC && GC_ERGONOMICS
+  if (value >= 0) {
+    memoryState->gcTargetPauseMicros = value;
+  }
+#endif
+}
+
+KLong Kotlin_native_internal_GC_getTargetPauseMicros(KRef) {
+#if USE_GC && GC_ERGONOMICS
+  return memoryState->gcTargetPauseMicros;
+#else
+  return -1;
+#endif
+}
+
+void Kotlin_native_internal_GC_setAllocationThreshold(KRef, KLong value) {
+#if USE_GC && GC_ERGONOMICS
+  if (value >= 0) {
+    memoryState->gcAllocationThreshold = value;
+  }
+#endif
+}
+
+KLong Kotlin_native_internal_GC_getAllocationThreshold(KRef) {
+#if USE_GC && GC_ERGONOMICS
+  return memoryState->gcAllocationThreshold;
+#else
+  return -1;
+#endif
+}
+
 KNativePtr CreateStablePointer(KRef any) {
   if (any == nullptr) return nullptr;
   AddRef(any);
@@ -1618,6 +3721,9 @@ OBJ_GETTER(AdoptStablePointer, KNativePtr pointer) {
   __sync_synchronize();
 #endif
   KRef ref = reinterpret_cast<KRef>(pointer);
+#if USE_CONTAINER_ALLOCATOR
+  if (ref != nullptr) TransferArena::adopt(ref->container(), memoryState);
+#endif
   UpdateRef(OBJ_RESULT, nullptr);
   // Somewhat hacky.
   *OBJ_RESULT = ref;
@@ -1625,22 +3731,35 @@ OBJ_GETTER(AdoptStablePointer, KNativePtr pointer) {
 }
 
 #if USE_GC
-bool hasExternalRefs(ContainerHeader* start, ContainerHeaderSet* visited) {
-  ContainerHeaderDeque toVisit;
-  toVisit.push_back(start);
-  while (!toVisit.empty()) {
-    auto* container = toVisit.front();
-    toVisit.pop_front();
-    visited->insert(container);
-    if (container->refCount() != 0) return true;
-    traverseContainerReferredObjects(container, [&toVisit, visited](ObjHeader* ref) {
+// Uses 'seen' bit to mark containers to visit, all visited containers are added to `visited`.
+bool hasExternalRefs(ContainerHeader* start, KStdVector<ContainerHeader*>* visited) {
+  auto& toVisit = *memoryState->markStack;
+  auto base = toVisit.size();
+  bool result = false;
+  toVisit.push(start);
+  start->setSeen();
+  while (toVisit.size() > base) {
+    auto* container = toVisit.pop();
+    visited->push_back(container);
+    if (container->refCount() != 0) {
+      result = true;
+      break;
+    }
+    traverseContainerReferredObjectsPrefetching(container, [&toVisit](ObjHeader* ref) {
         auto* child = ref->container();
-        if (!Shareable(child) && (visited->count(child) == 0)) {
-           toVisit.push_front(child);
+        if (!Shareable(child) && !child->seen()) {
+           child->setSeen();
+           toVisit.push(child);
         }
      });
   }
-  return false;
+  while (toVisit.size() > base) {
+    toVisit.pop()->resetSeen();
+  }
+  for (auto* container : *visited) {
+    container->resetSeen();
+  }
+  return result;
 }
 #endif
 
@@ -1655,7 +3774,11 @@ bool ClearSubgraphReferences(ObjHeader* root, bool checked) {
       // GC candidate list.
       return true;
 
-    ContainerHeaderSet visited;
+#if USE_DEFERRED_STACK_RC
+    StackRefsCounted stackRefs(state);
+#endif
+
+    KStdVector<ContainerHeader*> visited;
     if (!checked) {
       hasExternalRefs(container, &visited);
     } else {
@@ -1669,20 +3792,140 @@ bool ClearSubgraphReferences(ObjHeader* root, bool checked) {
       }
     }
 
+#if USE_CONTAINER_ALLOCATOR
+    for (auto* container : visited) {
+      if (container->buffered()) {
+        removeCandidate(state, container);
+        container->setColorAssertIfGreen(CONTAINER_TAG_GC_BLACK);
+      }
+    }
+#else
     // TODO: not very efficient traversal.
-    for (auto it = state->toFree->begin(); it != state->toFree->end(); ++it) {
+    std::sort(visited.begin(), visited.end());
+    for (auto it = state->toFree->begin() + state->toFreeStart; it != state->toFree->end(); ++it) {
       auto container = *it;
-      if (visited.count(container) != 0) {
+      if (std::binary_search(visited.begin(), visited.end(), container)) {
         container->resetBuffered();
         container->setColorAssertIfGreen(CONTAINER_TAG_GC_BLACK);
         *it = markAsRemoved(container);
       }
     }
+#endif
   }
 #endif  // USE_GC
   return true;
 }
 
+#if USE_GC && USE_CONTAINER_ALLOCATOR
+
+namespace {
+
+// Result of detachArenaSubgraph().
+enum ArenaSubgraph {
+  // Subgraph is detached.
+  ARENA_SUBGRAPH_DETACHED,
+  // Subgraph is referred from outside.
+  ARENA_SUBGRAPH_REFERRED,
+  // Subgraph refers to containers outside of the arena, which must be checked by the full traversal.
+  ARENA_SUBGRAPH_ESCAPES
+};
+
+// Visits the arena containers reachable from `root` breadth-first, reference counts less references between
+// them must be zero, except for the reference to the root held by the caller. As the traversal never leaves
+// the arena, it visits only containers allocated there since the arena was opened.
+ArenaSubgraph detachArenaSubgraph(MemoryState* state, TransferArena* arena, ContainerHeader* root) {
+#if USE_DEFERRED_STACK_RC
+  StackRefsCounted stackRefs(state);
+#endif
+  KStdVector<ContainerHeader*> visited;
+  visited.push_back(root);
+  root->setSeen();
+  bool escapes = false;
+  for (size_t index = 0; index < visited.size(); ++index) {
+    traverseContainerReferredObjects(visited[index], [arena, &visited, &escapes](ObjHeader* ref) {
+      auto* child = ref->container();
+      if (Shareable(child)) return;
+      if (!arena->contains(child)) {
+        escapes = true;
+        return;
+      }
+      child->decRefCount<false>();
+      if (!child->seen()) {
+        child->setSeen();
+        visited.push_back(child);
+      }
+    });
+  }
+  bool referred = root->refCount() != 1;
+  for (auto* container : visited) {
+    if (container != root && container->refCount() != 0) referred = true;
+  }
+  for (auto* container : visited) {
+    container->resetSeen();
+    traverseContainerReferredObjects(container, [arena](ObjHeader* ref) {
+      auto* child = ref->container();
+      if (!Shareable(child) && arena->contains(child)) child->incRefCount<false>();
+    });
+  }
+  // References from containers outside of the arena are not subtracted, so the full check decides.
+  if (escapes) return ARENA_SUBGRAPH_ESCAPES;
+  if (referred) return ARENA_SUBGRAPH_REFERRED;
+  for (auto* container : visited) {
+    if (container->buffered()) {
+      removeCandidate(state, container);
+      container->setColorAssertIfGreen(CONTAINER_TAG_GC_BLACK);
+    }
+  }
+  return ARENA_SUBGRAPH_DETACHED;
+}
+
+}  // namespace
+
+#endif  // USE_GC && USE_CONTAINER_ALLOCATOR
+
+TransferArena* OpenTransferArena() {
+#if USE_CONTAINER_ALLOCATOR
+  auto* state = memoryState;
+  state->transferArena = konanConstructInstance<TransferArena>(state->transferArena, state);
+  return state->transferArena;
+#else
+  return nullptr;
+#endif
+}
+
+void CloseTransferArena(TransferArena* arena) {
+#if USE_CONTAINER_ALLOCATOR
+  if (arena == nullptr) return;
+  auto* state = memoryState;
+  RuntimeAssert(state->transferArena == arena, "Transfer arenas must be closed in reverse order");
+  state->transferArena = arena->previous();
+  arena->close();
+#endif
+}
+
+bool ClearArenaReferences(TransferArena* arena, ObjHeader* root) {
+#if USE_GC && USE_CONTAINER_ALLOCATOR
+  if (arena != nullptr && root != nullptr) {
+    auto* container = root->container();
+    if (container != nullptr && !container->frozen() && arena->contains(container)) {
+      switch (detachArenaSubgraph(memoryState, arena, container)) {
+        case ARENA_SUBGRAPH_DETACHED:
+          return true;
+        case ARENA_SUBGRAPH_REFERRED:
+          return false;
+        case ARENA_SUBGRAPH_ESCAPES:
+          break;
+      }
+    }
+  }
+#endif  // USE_GC && USE_CONTAINER_ALLOCATOR
+  return ClearSubgraphReferences(root, true);
+}
+
+inline bool isNeverFrozen(ObjHeader* obj) {
+  return obj->has_meta_object() && ((obj->meta_object()->flags_ & MF_NEVER_FROZEN) != 0);
+}
+
 /**
   * Do DFS cycle detection with three colors:
   *  - 'marked' bit as BLACK marker (object and its descendants processed)
@@ -1692,13 +3935,13 @@ bool ClearSubgraphReferences(ObjHeader* root, bool checked) {
   */
 void depthFirstTraversal(ContainerHeader* start, bool* hasCycles,
                          KRef* firstBlocker, KStdVector<ContainerHeader*>* order) {
-  ContainerHeaderDeque toVisit;
-  toVisit.push_back(start);
+  auto& toVisit = *memoryState->markStack;
+  auto base = toVisit.size();
+  toVisit.push(start);
   start->setSeen();
 
-  while (!toVisit.empty()) {
-    auto* container = toVisit.front();
-    toVisit.pop_front();
+  while (toVisit.size() > base) {
+    auto* container = toVisit.pop();
     if (isMarkedAsRemoved(container)) {
       container = clearRemoved(container);
       // Mark BLACK.
@@ -1707,11 +3950,11 @@ void depthFirstTraversal(ContainerHeader* start, bool* hasCycles,
       order->push_back(container);
       continue;
     }
-    toVisit.push_front(markAsRemoved(container));
-    traverseContainerReferredObjects(container, [hasCycles, firstBlocker, &order, &toVisit](ObjHeader* obj) {
+    toVisit.push(markAsRemoved(container));
+    traverseContainerReferredObjectsPrefetching(container, [hasCycles, firstBlocker, &order, &toVisit](ObjHeader* obj) {
       if (*firstBlocker != nullptr)
         return;
-      if (obj->has_meta_object() && ((obj->meta_object()->flags_ & MF_NEVER_FROZEN) != 0)) {
+      if (isNeverFrozen(obj)) {
           *firstBlocker = obj;
           return;
       }
@@ -1724,76 +3967,188 @@ void depthFirstTraversal(ContainerHeader* start, bool* hasCycles,
         if (!objContainer->seen() && !objContainer->marked()) {
           // Mark GRAY.
           objContainer->setSeen();
-          toVisit.push_front(objContainer);
+          toVisit.push(objContainer);
         }
       }
     });
   }
 }
 
+// Edge of the object graph, as (to, from) pair.
+typedef std::pair<ContainerHeader*, ContainerHeader*> ContainerEdge;
+
+inline bool edgeTargetLess(const ContainerEdge& first, const ContainerEdge& second) {
+  return first.first < second.first;
+}
+
+// Reversed edges must be sorted by edge target.
 void traverseStronglyConnectedComponent(ContainerHeader* start,
-                                        KStdUnorderedMap<ContainerHeader*,
-                                            KStdVector<ContainerHeader*>> const* reversedEdges,
+                                        const KStdVector<ContainerEdge>& reversedEdges,
                                         KStdVector<ContainerHeader*>* component) {
-  ContainerHeaderDeque toVisit;
-  toVisit.push_back(start);
+  auto& toVisit = *memoryState->markStack;
+  auto base = toVisit.size();
+  toVisit.push(start);
   start->mark();
 
-  while (!toVisit.empty()) {
-    auto* container = toVisit.front();
-    toVisit.pop_front();
+  while (toVisit.size() > base) {
+    auto* container = toVisit.pop();
     component->push_back(container);
-    auto it = reversedEdges->find(container);
-    RuntimeAssert(it != reversedEdges->end(), "unknown node during condensation building");
-    for (auto* nextContainer : it->second) {
+    auto range = std::equal_range(reversedEdges.begin(), reversedEdges.end(),
+        ContainerEdge(container, nullptr), edgeTargetLess);
+    for (auto it = range.first; it != range.second; ++it) {
+      auto* nextContainer = it->second;
       if (!nextContainer->marked()) {
           nextContainer->mark();
-          toVisit.push_front(nextContainer);
+          toVisit.push(nextContainer);
+      }
+    }
+  }
+}
+
+// Freezes container, which is not a part of any reference cycle.
+inline void freezeContainer(ContainerHeader* container) {
+#if USE_GC && USE_CONTAINER_ALLOCATOR
+  if (container->buffered()) removeCandidate(memoryState, container);
+#else
+  container->resetBuffered();
+#endif
+  container->setColorUnlessGreen(CONTAINER_TAG_GC_BLACK);
+#if USE_BIASED_RC
+  biasContainer(memoryState, container);
+#endif
+  // Note, that once object is frozen, it could be concurrently accessed, so
+  // color and similar attributes shall not be used.
+  container->freeze();
+}
+
+// If container holds an object of acyclic type, i.e. one referring only to objects of acyclic types,
+// so no reference cycle passes through it.
+inline bool isAcyclicTyped(ContainerHeader* container) {
+  return !container->stack() && container->color() == CONTAINER_TAG_GC_GREEN;
+}
+
+/**
+ * Freezes subgraph of containers of acyclic types, which needs neither cycle detection nor
+ * the second traversal done by freezeAcyclic(). Returns false, having frozen nothing, if containers
+ * of other types are reachable, and then the general algorithm must be used. If there's a blocker,
+ * nothing is frozen either, and it is stored to `firstBlocker`.
+ */
+bool freezeAcyclicTyped(ContainerHeader* rootContainer, KRef* firstBlocker) {
+  KStdVector<ContainerHeader*> visited;
+  visited.push_back(rootContainer);
+  rootContainer->mark();
+  bool acyclic = true;
+  for (size_t index = 0; index < visited.size() && acyclic && *firstBlocker == nullptr; ++index) {
+    traverseContainerReferredObjects(visited[index], [&visited, &acyclic, firstBlocker](ObjHeader* obj) {
+      if (!acyclic || *firstBlocker != nullptr)
+        return;
+      if (isNeverFrozen(obj)) {
+        *firstBlocker = obj;
+        return;
+      }
+      ContainerHeader* objContainer = obj->container();
+      if (Shareable(objContainer) || objContainer->marked())
+        return;
+      if (!isAcyclicTyped(objContainer)) {
+        acyclic = false;
+        return;
       }
+      objContainer->mark();
+      visited.push_back(objContainer);
+    });
+  }
+  for (auto* container : visited) {
+    container->unMark();
+  }
+  if (!acyclic) return false;
+  if (*firstBlocker == nullptr) {
+    for (auto* container : visited) {
+      freezeContainer(container);
     }
   }
+  return true;
 }
 
 void freezeAcyclic(ContainerHeader* rootContainer) {
-  KStdDeque<ContainerHeader*> queue;
-  queue.push_back(rootContainer);
-  while (!queue.empty()) {
-    ContainerHeader* current = queue.front();
-    queue.pop_front();
+  auto& queue = *memoryState->markStack;
+  auto base = queue.size();
+  queue.push(rootContainer);
+  while (queue.size() > base) {
+    ContainerHeader* current = queue.pop();
     current->unMark();
-    current->resetBuffered();
-    current->setColorUnlessGreen(CONTAINER_TAG_GC_BLACK);
-    // Note, that once object is frozen, it could be concurrently accessed, so
-    // color and similar attributes shall not be used.
-    current->freeze();
-    traverseContainerReferredObjects(current, [current, &queue](ObjHeader* obj) {
+    freezeContainer(current);
+    traverseContainerReferredObjectsPrefetching(current, [current, &queue](ObjHeader* obj) {
         ContainerHeader* objContainer = obj->container();
         if (!Shareable(objContainer)) {
           if (objContainer->marked())
-            queue.push_back(objContainer);
+            queue.push(objContainer);
         }
     });
   }
 }
 
+// Freezes set of containers, which all refer only to each other or to shared objects, as a whole:
+// they are aggregated into a single frozen container, released once none of them is referred from outside.
+void freezeComponent(KStdVector<ContainerHeader*>& component) {
+  int internalRefsCount = 0;
+  int totalCount = 0;
+  for (auto* container : component) {
+    totalCount += container->refCount();
+    traverseContainerReferredObjects(container, [&internalRefsCount](ObjHeader* obj) {
+      auto* container = obj->container();
+      if (!Shareable(container))
+        ++internalRefsCount;
+    });
+  }
+
+#if USE_BIASED_RC
+  bool biasable = component.size() > 1 || !component[0]->stack();
+#endif
+  // Freeze component.
+  for (auto* container : component) {
+#if USE_GC && USE_CONTAINER_ALLOCATOR
+    if (container->buffered()) removeCandidate(memoryState, container);
+#else
+    container->resetBuffered();
+#endif
+    container->setColorUnlessGreen(CONTAINER_TAG_GC_BLACK);
+    // Note, that once object is frozen, it could be concurrently accessed, so
+    // color and similar attributes shall not be used.
+    container->freeze();
+    // We set refcount of original container to zero, so that it is seen as such after removal
+    // meta-object, where aggregating container is stored.
+    container->setRefCount(0);
+  }
+  // Create fictitious container for the whole component.
+  auto superContainer = component.size() == 1 ? component[0] : AllocAggregatingFrozenContainer(component);
+  // Don't count internal references.
+  superContainer->setRefCount(totalCount - internalRefsCount);
+#if USE_BIASED_RC
+  if (biasable) biasContainer(memoryState, superContainer);
+#endif
+}
+
 void freezeCyclic(ContainerHeader* rootContainer, const KStdVector<ContainerHeader*>& order) {
-  KStdUnorderedMap<ContainerHeader*, KStdVector<ContainerHeader*>> reversedEdges;
-  KStdDeque<ContainerHeader*> queue;
-  queue.push_back(rootContainer);
-  while (!queue.empty()) {
-    ContainerHeader* current = queue.front();
-    queue.pop_front();
+  // Reversed edges of the subgraph, sorted by target, so that edges to the given container can be found
+  // with binary search.
+  KStdVector<ContainerEdge> reversedEdges;
+  reversedEdges.reserve(order.size());
+  auto& queue = *memoryState->markStack;
+  auto base = queue.size();
+  queue.push(rootContainer);
+  while (queue.size() > base) {
+    ContainerHeader* current = queue.pop();
     current->unMark();
-    reversedEdges.emplace(current, KStdVector<ContainerHeader*>(0));
-    traverseContainerReferredObjects(current, [current, &queue, &reversedEdges](ObjHeader* obj) {
+    traverseContainerReferredObjectsPrefetching(current, [current, &queue, &reversedEdges](ObjHeader* obj) {
           ContainerHeader* objContainer = obj->container();
           if (!Shareable(objContainer)) {
             if (objContainer->marked())
-              queue.push_back(objContainer);
-            reversedEdges.emplace(objContainer, KStdVector<ContainerHeader*>(0)).first->second.push_back(current);
+              queue.push(objContainer);
+            reversedEdges.emplace_back(objContainer, current);
           }
       });
     }
+    std::sort(reversedEdges.begin(), reversedEdges.end(), edgeTargetLess);
 
     KStdVector<KStdVector<ContainerHeader*>> components;
     MEMORY_LOG("Condensation:\n");
@@ -1802,7 +4157,7 @@ void freezeCyclic(ContainerHeader* rootContainer, const KStdVector<ContainerHead
       auto* container = *it;
       if (container->marked()) continue;
       KStdVector<ContainerHeader*> component;
-      traverseStronglyConnectedComponent(container, &reversedEdges, &component);
+      traverseStronglyConnectedComponent(container, reversedEdges, &component);
       MEMORY_LOG("SCC:\n");
   #if TRACE_MEMORY
       for (auto c: component)
@@ -1813,33 +4168,7 @@ void freezeCyclic(ContainerHeader* rootContainer, const KStdVector<ContainerHead
 
     // Enumerate strongly connected components in reversed topological order.
   for (auto it = components.rbegin(); it != components.rend(); ++it) {
-    auto& component = *it;
-    int internalRefsCount = 0;
-    int totalCount = 0;
-    for (auto* container : component) {
-      totalCount += container->refCount();
-      traverseContainerReferredObjects(container, [&internalRefsCount](ObjHeader* obj) {
-          auto* container = obj->container();
-          if (!Shareable(container))
-              ++internalRefsCount;
-        });
-      }
-
-    // Freeze component.
-    for (auto* container : component) {
-      container->resetBuffered();
-      container->setColorUnlessGreen(CONTAINER_TAG_GC_BLACK);
-      // Note, that once object is frozen, it could be concurrently accessed, so
-      // color and similar attributes shall not be used.
-      container->freeze();
-      // We set refcount of original container to zero, so that it is seen as such after removal
-      // meta-object, where aggregating container is stored.
-      container->setRefCount(0);
-    }
-    // Create fictitious container for the whole component.
-    auto superContainer = component.size() == 1 ? component[0] : AllocAggregatingFrozenContainer(component);
-    // Don't count internal references.
-    superContainer->setRefCount(totalCount - internalRefsCount);
+    freezeComponent(*it);
   }
 }
 
@@ -1873,34 +4202,98 @@ void FreezeSubgraph(ObjHeader* root) {
   ContainerHeader* rootContainer = root->container();
   if (Shareable(rootContainer)) return;
 
-  // Do DFS cycle detection.
+#if USE_DEFERRED_STACK_RC
+  // Once frozen, objects could be released by other threads, so references from the stack must be counted.
+  StackRefsCounted stackRefs(memoryState);
+#endif
+
+  KRef firstBlocker = isNeverFrozen(root) ? root : nullptr;
+  // Graphs of acyclic types are frozen by a single traversal.
+  bool frozen = firstBlocker == nullptr && isAcyclicTyped(rootContainer) &&
+      freezeAcyclicTyped(rootContainer, &firstBlocker);
+
+  // Otherwise do DFS cycle detection.
   bool hasCycles = false;
-  KRef firstBlocker = root->has_meta_object() && ((root->meta_object()->flags_ & MF_NEVER_FROZEN) != 0) ?
-    root : nullptr;
   KStdVector<ContainerHeader*> order;
-  depthFirstTraversal(rootContainer, &hasCycles, &firstBlocker, &order);
+  if (!frozen)
+    depthFirstTraversal(rootContainer, &hasCycles, &firstBlocker, &order);
   if (firstBlocker != nullptr) {
     ThrowFreezingException(root, firstBlocker);
   }
   // Now unmark all marked objects, and freeze them, if no cycles detected.
-  if (hasCycles) {
-    freezeCyclic(rootContainer, order);
-  } else {
-    freezeAcyclic(rootContainer );
+  if (!frozen) {
+    if (hasCycles) {
+      freezeCyclic(rootContainer, order);
+    } else {
+      freezeAcyclic(rootContainer );
+    }
   }
 
-#if USE_GC
+#if USE_GC && !USE_CONTAINER_ALLOCATOR
   // Now remove frozen objects from the toFree list.
   // TODO: optimize it by keeping ignored (i.e. freshly frozen) objects in the set,
   // and use it when analyzing toFree during collection.
   auto state = memoryState;
-  for (auto& container : *(state->toFree)) {
+  for (auto it = state->toFree->begin() + state->toFreeStart; it != state->toFree->end(); ++it) {
+      auto& container = *it;
       if (!isMarkedAsRemoved(container) && container->frozen())
         container = markAsRemoved(container);
   }
 #endif
 }
 
+void FreezeArenaSubgraph(TransferArena* arena, ObjHeader* root) {
+#if USE_CONTAINER_ALLOCATOR
+  if (arena != nullptr && root != nullptr) {
+    ContainerHeader* rootContainer = root->container();
+    if (Shareable(rootContainer)) return;
+    if (arena->contains(rootContainer)) {
+#if USE_DEFERRED_STACK_RC
+      StackRefsCounted stackRefs(memoryState);
+#endif
+#if USE_GC
+      // Free temporaries of the producer first, so that arena chunks holding nothing else are released.
+      auto* state = memoryState;
+      if (!state->gcInProgress && state->finalizerQueueSuspendCount == 0) processFinalizerQueue(state);
+#endif
+      // Containers reachable from the root, if all of them are allocated in the arena.
+      KStdVector<ContainerHeader*> component;
+      component.push_back(rootContainer);
+      rootContainer->setSeen();
+      KRef firstBlocker = isNeverFrozen(root) ? root : nullptr;
+      bool escapes = false;
+      for (size_t index = 0; index < component.size() && !escapes && firstBlocker == nullptr; ++index) {
+        traverseContainerReferredObjects(component[index], [arena, &component, &firstBlocker, &escapes](ObjHeader* obj) {
+          if (firstBlocker == nullptr && isNeverFrozen(obj))
+            firstBlocker = obj;
+          ContainerHeader* objContainer = obj->container();
+          if (Shareable(objContainer) || objContainer->seen())
+            return;
+          if (!arena->contains(objContainer)) {
+            escapes = true;
+            return;
+          }
+          objContainer->setSeen();
+          component.push_back(objContainer);
+        });
+      }
+      for (auto* container : component) {
+        container->resetSeen();
+      }
+      if (firstBlocker != nullptr) {
+        ThrowFreezingException(root, firstBlocker);
+      }
+      if (!escapes) {
+        // Objects built together die together, so no need to find strongly connected components.
+        freezeComponent(component);
+        return;
+      }
+    }
+  }
+#endif  // USE_CONTAINER_ALLOCATOR
+  FreezeSubgraph(root);
+}
+
 // This function is called from field mutators to check if object's header is frozen.
 // If object is frozen, an exception is thrown.
 void MutationCheck(ObjHeader* obj) {
@@ -1912,18 +4305,19 @@ OBJ_GETTER(SwapRefLocked,
     ObjHeader** location, ObjHeader* expectedValue, ObjHeader* newValue, int32_t* spinlock) {
   lock(spinlock);
   ObjHeader* oldValue = *location;
+  bool swapped = oldValue == expectedValue;
   // We do not use UpdateRef() here to avoid having ReleaseRef() on return slot under the lock.
-  if (oldValue == expectedValue) {
-    SetRef(location, newValue);
-  } else {
-    // We create an additional reference to the [oldValue] in the return slot.
-    if (oldValue != nullptr && isRefCounted(oldValue)) {
-      AddRef(oldValue);
-    }
+  if (swapped) {
+    setRefShared(location, newValue);
+  }
+  // We create an additional reference to the [oldValue] in the return slot.
+  if (oldValue != nullptr && isRefCounted(oldValue)) {
+    AddRef(oldValue);
   }
   unlock(spinlock);
-  // [oldValue] ownership was either transferred from *location to return slot if CAS succeeded, or
-  // we explicitly added a new reference if CAS failed.
+  // Reference from *location is released once no reader could be adding a reference to [oldValue].
+  if (swapped)
+    retireRef(memoryState, oldValue);
   updateReturnRefAdded(OBJ_RESULT, oldValue);
   return oldValue;
 }
@@ -1932,19 +4326,26 @@ void SetRefLocked(ObjHeader** location, ObjHeader* newValue, int32_t* spinlock)
   lock(spinlock);
   ObjHeader* oldValue = *location;
   // We do not use UpdateRef() here to avoid having ReleaseRef() on old value under the lock.
-  SetRef(location, newValue);
+  setRefShared(location, newValue);
   unlock(spinlock);
-  if (oldValue != nullptr)
-    ReleaseRef(oldValue);
+  retireRef(memoryState, oldValue);
 }
 
-OBJ_GETTER(ReadRefLocked, ObjHeader** location, int32_t* spinlock) {
-  lock(spinlock);
-  ObjHeader* value = *location;
-  // We do not use UpdateRef() here to avoid having ReleaseRef() on return slot under the lock.
-  if (value != nullptr)
-    AddRef(value);
-  unlock(spinlock);
+OBJ_GETTER(ReadRefLockFree, ObjHeader** location) {
+  auto* record = hazardRecord(memoryState);
+  ObjHeader* value;
+  while (true) {
+    value = atomicGet(location);
+    if (value == nullptr) break;
+    atomicSet(&record->hazard, value);
+    // If location still holds the value, writer who removes it later will see it announced.
+    if (atomicGet(location) != value) continue;
+    // We do not use UpdateRef() here to avoid having ReleaseRef() on return slot while announcing the value.
+    if (isRefCounted(value))
+      AddRef(value);
+    break;
+  }
+  atomicSet(&record->hazard, static_cast<ObjHeader*>(nullptr));
   updateReturnRefAdded(OBJ_RESULT, value);
   return value;
 }
@@ -2004,6 +4405,9 @@ void Kotlin_Any_share(ObjHeader* obj) {
     auto* container = obj->container();
     if (Shareable(container)) return;
     RuntimeCheck(container->objectCount() == 1, "Must be a single object container");
+#if USE_DEFERRED_STACK_RC
+    StackRefsCounted stackRefs(memoryState);
+#endif
     container->makeShareable();
 }
 
@@ -64,7 +64,13 @@ typedef enum {
   // Individual state bits used during GC and freezing.
   CONTAINER_TAG_GC_MARKED   = 1 << CONTAINER_TAG_COLOR_SHIFT,
   CONTAINER_TAG_GC_BUFFERED = 1 << (CONTAINER_TAG_COLOR_SHIFT + 1),
-  CONTAINER_TAG_GC_SEEN     = 1 << (CONTAINER_TAG_COLOR_SHIFT + 2)
+  CONTAINER_TAG_GC_SEEN     = 1 << (CONTAINER_TAG_COLOR_SHIFT + 2),
+  // Frozen container has an owner thread counting its references separately.
+  // Frozen containers never take part in traversals, so 'seen' bit is reused.
+  CONTAINER_TAG_GC_BIASED   = CONTAINER_TAG_GC_SEEN,
+  // Container with zero reference count awaits reconciliation with references from the stack.
+  // No such containers exist while 'marked' bit is used, so it is reused.
+  CONTAINER_TAG_GC_ZERO_COUNT = CONTAINER_TAG_GC_MARKED
 } ContainerTag;
 
 typedef enum {
@@ -118,24 +124,25 @@ struct ContainerHeader {
   }
 
   template <bool Atomic>
-  inline void incRefCount() {
+  inline void incRefCount(unsigned count = 1) {
 #ifdef KONAN_NO_THREADS
-    refCount_ += CONTAINER_TAG_INCREMENT;
+    refCount_ += CONTAINER_TAG_INCREMENT * count;
 #else
     if (Atomic)
-      __sync_add_and_fetch(&refCount_, CONTAINER_TAG_INCREMENT);
+      __sync_add_and_fetch(&refCount_, CONTAINER_TAG_INCREMENT * count);
     else
-      refCount_ += CONTAINER_TAG_INCREMENT;
+      refCount_ += CONTAINER_TAG_INCREMENT * count;
 #endif
   }
 
   template <bool Atomic>
-  inline int decRefCount() {
+  inline int decRefCount(unsigned count = 1) {
 #ifdef KONAN_NO_THREADS
-    int value = refCount_ -= CONTAINER_TAG_INCREMENT;
+    int value = refCount_ -= CONTAINER_TAG_INCREMENT * count;
 #else
     int value = Atomic ?
-       __sync_sub_and_fetch(&refCount_, CONTAINER_TAG_INCREMENT) : refCount_ -= CONTAINER_TAG_INCREMENT;
+       __sync_sub_and_fetch(&refCount_, CONTAINER_TAG_INCREMENT * count) :
+       refCount_ -= CONTAINER_TAG_INCREMENT * count;
 #endif
     return value >> CONTAINER_TAG_SHIFT;
   }
@@ -213,6 +220,26 @@ struct ContainerHeader {
     objectCount_ &= ~CONTAINER_TAG_GC_SEEN;
   }
 
+  inline bool zeroCount() const {
+    return (objectCount_ & CONTAINER_TAG_GC_ZERO_COUNT) != 0;
+  }
+
+  inline void setZeroCount() {
+    objectCount_ |= CONTAINER_TAG_GC_ZERO_COUNT;
+  }
+
+  inline void resetZeroCount() {
+    objectCount_ &= ~CONTAINER_TAG_GC_ZERO_COUNT;
+  }
+
+  inline bool biased() const {
+    return (objectCount_ & CONTAINER_TAG_GC_BIASED) != 0;
+  }
+
+  inline void setBiased() {
+    objectCount_ |= CONTAINER_TAG_GC_BIASED;
+  }
+
   // We cannot use 'this' here, as it conflicts with aliasing analysis in clang.
   inline void setNextLink(ContainerHeader* next) {
     *reinterpret_cast<ContainerHeader**>(this + 1) = next;
@@ -395,6 +422,8 @@ class ArenaContainer;
 struct ContainerChunk {
   ContainerChunk* next;
   ArenaContainer* arena;
+  // Size of the chunk, including this header.
+  container_size_t size;
   // Then we have ContainerHeader here.
   ContainerHeader* asHeader() {
     return reinterpret_cast<ContainerHeader*>(this + 1);
@@ -417,13 +446,21 @@ class ArenaContainer {
   ObjHeader** getSlot();
 
  private:
-  void* place(container_size_t size);
+  // Places `size` bytes, and sets `container` to the container holding them.
+  void* place(container_size_t size, ContainerHeader** container);
 
+  // Allocates new chunk with at least `minSize` bytes of space and makes it current.
   bool allocContainer(container_size_t minSize);
 
-  void setHeader(ObjHeader* obj, const TypeInfo* typeInfo) {
+  // Allocates chunk with `capacity` bytes of space, not linked to this arena yet.
+  ContainerChunk* allocChunk(container_size_t capacity);
+
+  // Frees the chunk or keeps it for reuse, `used` is the end of used part of the chunk, or null if it is full.
+  void releaseChunk(ContainerChunk* chunk, uint8_t* used);
+
+  void setHeader(ObjHeader* obj, const TypeInfo* typeInfo, ContainerHeader* container) {
     obj->typeInfoOrMeta_ = const_cast<TypeInfo*>(typeInfo);
-    obj->setContainer(currentChunk_->asHeader());
+    obj->setContainer(container);
     // Here we do not take into account typeInfo's immutability for ARC strategy, as there's no ARC.
   }
 
@@ -432,6 +469,8 @@ class ArenaContainer {
   uint8_t* end_;
   ArrayHeader* slots_;
   uint32_t slotsCount_;
+  // Capacity of the last allocated chunk, next chunk is twice as large.
+  container_size_t chunkCapacity_;
 };
 
 #ifdef __cplusplus
@@ -457,6 +496,7 @@ extern "C" {
   }
 
 struct MemoryState;
+class TransferArena;
 
 MemoryState* InitMemory();
 void DeinitMemory(MemoryState*);
@@ -512,33 +552,52 @@ void WeakReferenceCounterClear(ObjHeader* counter);
 void SetRef(ObjHeader** location, const ObjHeader* object) RUNTIME_NOTHROW;
 // Updates location.
 void UpdateRef(ObjHeader** location, const ObjHeader* object) RUNTIME_NOTHROW;
+// Updates local variable slot of the current frame, references from such slots may be not counted.
+void UpdateStackRef(ObjHeader** location, const ObjHeader* object) RUNTIME_NOTHROW;
 // Updates location if it is null, atomically.
 void UpdateRefIfNull(ObjHeader** location, const ObjHeader* object) RUNTIME_NOTHROW;
 // Updates reference in return slot.
 void UpdateReturnRef(ObjHeader** returnSlot, const ObjHeader* object) RUNTIME_NOTHROW;
-// Compares and swaps reference with taken lock.
+// Compares and swaps reference with taken lock, location could be concurrently read with ReadRefLockFree().
 OBJ_GETTER(SwapRefLocked,
     ObjHeader** location, ObjHeader* expectedValue, ObjHeader* newValue, int32_t* spinlock) RUNTIME_NOTHROW;
-// Sets reference with taken lock.
+// Sets reference with taken lock, location could be concurrently read with ReadRefLockFree().
 void SetRefLocked(ObjHeader** location, ObjHeader* newValue, int32_t* spinlock) RUNTIME_NOTHROW;
-// Reads reference with taken lock.
-OBJ_GETTER(ReadRefLocked, ObjHeader** location, int32_t* spinlock) RUNTIME_NOTHROW;
+// Reads reference updated by SwapRefLocked() and SetRefLocked() without taking the lock.
+OBJ_GETTER(ReadRefLockFree, ObjHeader** location) RUNTIME_NOTHROW;
 // Optimization: release all references in range.
 void ReleaseRefs(ObjHeader** start, int count) RUNTIME_NOTHROW;
-// Called on frame enter, if it has object slots.
-void EnterFrame(ObjHeader** start, int parameters, int count) RUNTIME_NOTHROW;
+// Copies `count` references from `source` to `destination`, ranges may overlap.
+// Reference counts of the same container are updated at once.
+void UpdateRefRange(ObjHeader** destination, ObjHeader* const* source, int count) RUNTIME_NOTHROW;
+// Stores `object` into `count` locations starting from `destination`.
+void FillRefRange(ObjHeader** destination, const ObjHeader* object, int count) RUNTIME_NOTHROW;
+// Called on frame enter, if it has object slots. Local variable slots follow `count` other slots.
+void EnterFrame(ObjHeader** start, int parameters, int count, int stackCount) RUNTIME_NOTHROW;
 // Called on frame leave, if it has object slots.
-void LeaveFrame(ObjHeader** start, int parameters, int count) RUNTIME_NOTHROW;
+void LeaveFrame(ObjHeader** start, int parameters, int count, int stackCount) RUNTIME_NOTHROW;
 // Tries to use returnSlot's arena for allocation.
 ObjHeader** GetReturnSlotIfArena(ObjHeader** returnSlot, ObjHeader** localSlot) RUNTIME_NOTHROW;
 // Tries to use param's arena for allocation.
 ObjHeader** GetParamSlotIfArena(ObjHeader* param, ObjHeader** localSlot) RUNTIME_NOTHROW;
 // Collect garbage, which cannot be found by reference counting (cycles).
 void GarbageCollect() RUNTIME_NOTHROW;
+// Collect pending cycle candidates within a short time budget, called by threads having nothing else to do.
+// Does nothing if called again soon, unless collection threshold is reached.
+void GarbageCollectIdle() RUNTIME_NOTHROW;
 // Clears object subgraph references from memory subsystem, and optionally
 // checks if subgraph referenced by given root is disjoint from the rest of
 // object graph, i.e. no external references exists.
 bool ClearSubgraphReferences(ObjHeader* root, bool checked) RUNTIME_NOTHROW;
+// Starts placing containers allocated by the current thread in a new transfer arena, until it is closed.
+// Returns nullptr if arenas are not supported by the memory manager.
+TransferArena* OpenTransferArena() RUNTIME_NOTHROW;
+// Stops placing containers in the arena, which must be the last one opened by the current thread.
+// Arena memory is freed once all containers allocated there are freed.
+void CloseTransferArena(TransferArena* arena) RUNTIME_NOTHROW;
+// Same as checked ClearSubgraphReferences(), but subgraph allocated in the arena being still open
+// is checked by a traversal bounded by the arena.
+bool ClearArenaReferences(TransferArena* arena, ObjHeader* root) RUNTIME_NOTHROW;
 // Creates stable pointer out of the object.
 void* CreateStablePointer(ObjHeader* obj) RUNTIME_NOTHROW;
 // Disposes stable pointer to the object.
@@ -551,6 +610,9 @@ OBJ_GETTER(AdoptStablePointer, void*) RUNTIME_NOTHROW;
 void MutationCheck(ObjHeader* obj);
 // Freeze object subgraph.
 void FreezeSubgraph(ObjHeader* obj);
+// Freeze object subgraph built in the arena being still open. Reachable objects allocated in the arena are
+// frozen as a whole, without cycle detection, so they are released together too.
+void FreezeArenaSubgraph(TransferArena* arena, ObjHeader* root);
 // Ensure this object shall block freezing.
 void EnsureNeverFrozen(ObjHeader* obj);
 #ifdef __cplusplus
@@ -22,4 +22,22 @@
 void AddRefFromAssociatedObject(const ObjHeader* object) RUNTIME_NOTHROW;
 void ReleaseRefFromAssociatedObject(const ObjHeader* object) RUNTIME_NOTHROW;
 
+// Receives live heap of the current thread, see VisitHeap().
+class HeapVisitor {
+ public:
+  // Live container allocated by the current thread, and its reference count, including references
+  // counted by the thread owning biased frozen container. References from local variables are not counted.
+  virtual void visitContainer(const ContainerHeader* container, uint32_t refCount) = 0;
+  // Live object of `container`, of `size` bytes.
+  virtual void visitObject(const ObjHeader* object, const ContainerHeader* container, uint32_t size) = 0;
+  // Object referenced from a local variable slot of the current thread.
+  virtual void visitStackRoot(const ObjHeader* object) = 0;
+};
+
+// Reports all live containers allocated by the current thread, their objects, and objects referenced from
+// the stack to `visitor`. Containers allocated in transfer arenas are only reported while the arena is open,
+// once closed they belong to the thread the graph was transferred to. Returns false if containers are not
+// tracked in this runtime configuration.
+bool VisitHeap(HeapVisitor* visitor) RUNTIME_NOTHROW;
+
 #endif // RUNTIME_MEMORYPRIVATE_HPP
@@ -15,6 +15,7 @@
  */
 
 #include "Alloc.h"
+#include "AllocationProfiler.h"
 #include "Exceptions.h"
 #include "Memory.h"
 #include "Porting.h"
@@ -85,6 +86,7 @@ RuntimeState* initRuntime() {
   if (firstRuntime) {
     isMainThread = 1;
     konan::consoleInit();
+    InitAllocationProfiler();
 
     InitOrDeinitGlobalVariables(INIT_GLOBALS);
   }
@@ -95,8 +97,10 @@ RuntimeState* initRuntime() {
 void deinitRuntime(RuntimeState* state) {
   bool lastRuntime = atomicAdd(&aliveRuntimesCount, -1) == 0;
   InitOrDeinitGlobalVariables(DEINIT_THREAD_LOCAL_GLOBALS);
-  if (lastRuntime)
+  if (lastRuntime) {
     InitOrDeinitGlobalVariables(DEINIT_GLOBALS);
+    DeinitAllocationProfiler();
+  }
   DeinitMemory(state->memoryState);
   konanDestructInstance(state);
 }
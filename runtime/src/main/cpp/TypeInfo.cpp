@@ -15,6 +15,8 @@
  */
 
 #include "KAssert.h"
+#include "KString.h"
+#include "Porting.h"
 #include "TypeInfo.h"
 
 // If one shall use binary search when looking up methods and fields.
@@ -56,4 +58,17 @@ void* LookupOpenMethod(const TypeInfo* info, MethodNameHash nameSignature) {
 
 #endif
 
+void FormatTypeName(const TypeInfo* info, char* buffer, size_t size) {
+  char* packageName = info->packageName_ != nullptr ? CreateCStringFromString(info->packageName_) : nullptr;
+  char* relativeName = info->relativeName_ != nullptr ? CreateCStringFromString(info->relativeName_) : nullptr;
+  if (relativeName == nullptr)
+    konan::snprintf(buffer, size, "<anonymous>");
+  else if (packageName == nullptr || *packageName == '\0')
+    konan::snprintf(buffer, size, "%s", relativeName);
+  else
+    konan::snprintf(buffer, size, "%s.%s", packageName, relativeName);
+  if (packageName != nullptr) DisposeCString(packageName);
+  if (relativeName != nullptr) DisposeCString(relativeName);
+}
+
 }
@@ -17,6 +17,7 @@
 #ifndef RUNTIME_TYPEINFO_H
 #define RUNTIME_TYPEINFO_H
 
+#include <cstddef>
 #include <cstdint>
 
 #include "Common.h"
@@ -138,6 +139,9 @@ extern "C" {
 // (as TypeInfo is compile time constant and type info pointers are stable).
 void* LookupOpenMethod(const TypeInfo* info, MethodNameHash nameSignature) RUNTIME_CONST;
 
+// Writes fully qualified name of the type to `buffer` of `size` bytes, or "<anonymous>" if it has no name.
+void FormatTypeName(const TypeInfo* info, char* buffer, size_t size);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
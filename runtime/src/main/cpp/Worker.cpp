@@ -25,12 +25,16 @@
 #if WITH_WORKERS
 #include <pthread.h>
 #include <sys/time.h>
+#include <algorithm>
+#include <chrono>
 #endif
 
 #include "Alloc.h"
+#include "Atomic.h"
 #include "Exceptions.h"
 #include "KAssert.h"
 #include "Memory.h"
+#include "Natives.h"
 #include "Runtime.h"
 #include "Types.h"
 
@@ -39,11 +43,33 @@ extern "C" {
 RUNTIME_NORETURN void ThrowWorkerInvalidState();
 RUNTIME_NORETURN void ThrowWorkerUnsupported();
 OBJ_GETTER(WorkerLaunchpad, KRef);
+OBJ_GETTER(WorkerBatchLaunchpad, KRef, KInt);
 
 }  // extern "C"
 
 namespace {
 
+enum {
+  CHECKED = 0,
+  UNCHECKED = 1,
+  ARENA = 2
+};
+
+// Places objects allocated while in scope to a transfer arena in ARENA mode, so that the object graph
+// built there is transferred or frozen without traversing the rest of the heap.
+class ArenaScope {
+ public:
+  explicit ArenaScope(KInt mode) : arena_(mode == ARENA ? OpenTransferArena() : nullptr) {}
+  ~ArenaScope() {
+    CloseTransferArena(arena_);
+  }
+
+  TransferArena* arena() const { return arena_; }
+
+ private:
+  TransferArena* arena_;
+};
+
 #if WITH_WORKERS
 
 enum {
@@ -54,24 +80,26 @@ enum {
   THROWN = 4
 };
 
-enum {
-  CHECKED = 0,
-  UNCHECKED = 1
-};
+// Number of times idle worker checks its queue before going to sleep.
+constexpr int kWorkerSpinCount = 1000;
 
 THREAD_LOCAL_VARIABLE KInt g_currentWorkerId = 0;
 
-KNativePtr transfer(KRef object, KInt mode) {
+KNativePtr transfer(KRef object, KInt mode, TransferArena* arena = nullptr) {
   switch (mode) {
     case CHECKED:
     case UNCHECKED:
-      if (!ClearSubgraphReferences(object, mode == CHECKED)) {
+    case ARENA: {
+      bool detached = mode == ARENA ?
+          ClearArenaReferences(arena, object) : ClearSubgraphReferences(object, mode == CHECKED);
+      if (!detached) {
         // Release reference to the object, as it is not being managed by ObjHolder.
         UpdateRef(&object, nullptr);
         ThrowWorkerInvalidState();
         return nullptr;
       }
       return object;
+    }
   }
   return nullptr;
 }
@@ -89,6 +117,112 @@ class Locker {
   pthread_mutex_t* lock_;
 };
 
+class ReadLocker {
+ public:
+  explicit ReadLocker(pthread_rwlock_t* lock) : lock_(lock) {
+    pthread_rwlock_rdlock(lock_);
+  }
+  ~ReadLocker() {
+    pthread_rwlock_unlock(lock_);
+  }
+
+ private:
+  pthread_rwlock_t* lock_;
+};
+
+class WriteLocker {
+ public:
+  explicit WriteLocker(pthread_rwlock_t* lock) : lock_(lock) {
+    pthread_rwlock_wrlock(lock_);
+  }
+  ~WriteLocker() {
+    pthread_rwlock_unlock(lock_);
+  }
+
+ private:
+  pthread_rwlock_t* lock_;
+};
+
+// Time used for timeouts, not affected by changes of system time.
+KLong monotonicNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void initMonotonicCondition(pthread_cond_t* cond) {
+#if KONAN_MACOSX || KONAN_IOS || KONAN_WINDOWS
+  // Deadline is converted to a relative timeout in waitUntil().
+  pthread_cond_init(cond, nullptr);
+#else
+  pthread_condattr_t attributes;
+  pthread_condattr_init(&attributes);
+  pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+  pthread_cond_init(cond, &attributes);
+  pthread_condattr_destroy(&attributes);
+#endif
+}
+
+// Waits on condition initialized with initMonotonicCondition() until monotonicNanos() deadline.
+// Returns false once the deadline has passed.
+bool waitUntil(pthread_cond_t* cond, pthread_mutex_t* lock, KLong deadlineNanos) {
+  KLong remaining = deadlineNanos - monotonicNanos();
+  if (remaining <= 0) return false;
+  struct timespec ts;
+#if KONAN_MACOSX || KONAN_IOS
+  ts.tv_sec = remaining / 1000000000LL;
+  ts.tv_nsec = remaining % 1000000000LL;
+  pthread_cond_timedwait_relative_np(cond, lock, &ts);
+#elif KONAN_WINDOWS
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  KLong deadline = tv.tv_sec * 1000000000LL + tv.tv_usec * 1000LL + remaining;
+  ts.tv_sec = deadline / 1000000000LL;
+  ts.tv_nsec = deadline % 1000000000LL;
+  pthread_cond_timedwait(cond, lock, &ts);
+#else
+  ts.tv_sec = deadlineNanos / 1000000000LL;
+  ts.tv_nsec = deadlineNanos % 1000000000LL;
+  pthread_cond_timedwait(cond, lock, &ts);
+#endif
+  return true;
+}
+
+// Thread waiting for completion of any of the futures it is registered with, see State::waitForFutures().
+class FutureWaiter {
+ public:
+  FutureWaiter() : signalled_(false) {
+    pthread_mutex_init(&lock_, nullptr);
+    initMonotonicCondition(&cond_);
+  }
+
+  ~FutureWaiter() {
+    pthread_mutex_destroy(&lock_);
+    pthread_cond_destroy(&cond_);
+  }
+
+  void signal() {
+    Locker locker(&lock_);
+    signalled_ = true;
+    pthread_cond_signal(&cond_);
+  }
+
+  // Returns false once monotonicNanos() deadline has passed, negative deadline means waiting forever.
+  bool wait(KLong deadlineNanos) {
+    Locker locker(&lock_);
+    if (deadlineNanos < 0) {
+      while (!signalled_) pthread_cond_wait(&cond_, &lock_);
+      return true;
+    }
+    while (!signalled_ && waitUntil(&cond_, &lock_, deadlineNanos)) {}
+    return signalled_;
+  }
+
+ private:
+  pthread_mutex_t lock_;
+  pthread_cond_t cond_;
+  bool signalled_;
+};
+
 class Future {
  public:
   Future(KInt id) : state_(SCHEDULED), id_(id) {
@@ -118,11 +252,31 @@ class Future {
 
   void cancelUnlocked();
 
+  // Returns false if future is already completed.
+  bool addWaiterUnlocked(FutureWaiter* waiter) {
+    Locker locker(&lock_);
+    if (state_ != SCHEDULED) return false;
+    waiters_.push_back(waiter);
+    return true;
+  }
+
+  void removeWaiterUnlocked(FutureWaiter* waiter) {
+    Locker locker(&lock_);
+    auto it = std::find(waiters_.begin(), waiters_.end(), waiter);
+    if (it != waiters_.end()) waiters_.erase(it);
+  }
+
   // Those are called with the lock taken.
   KInt state() const { return state_; }
   KInt id() const { return id_; }
 
  private:
+  // Waiters are signalled with the lock taken, so that they may be gone once removed.
+  void signalWaiters() {
+    for (auto waiter : waiters_) waiter->signal();
+    waiters_.clear();
+  }
+
   // State of future execution.
   KInt state_;
   // Integer id of the future.
@@ -132,6 +286,8 @@ class Future {
   // Lock and condition for waiting on the future.
   pthread_mutex_t lock_;
   pthread_cond_t cond_;
+  // Threads waiting for this future among others.
+  KStdVector<FutureWaiter*> waiters_;
 };
 
 struct Job {
@@ -139,42 +295,119 @@ struct Job {
   KNativePtr argument;
   Future* future;
   KInt transferMode;
+  // If set, argument is an array, function is applied to each element, and the result is an array.
+  bool batch;
+};
+
+struct JobNode {
+  JobNode* volatile next;
+  Job job;
+};
+
+// Intrusive lock-free queue of jobs with many producers and single consumer (D. Vyukov's algorithm).
+// Producers never wait for each other nor for the consumer. Consumer may see the queue empty
+// while some producer is in the middle of `push()`, so producers must wake it up afterwards.
+class JobQueue {
+ public:
+  JobQueue() : head_(&stub_), tail_(&stub_) {
+    stub_.next = nullptr;
+  }
+
+  void push(JobNode* node) {
+    node->next = nullptr;
+    JobNode* previous = atomicExchange(&head_, node);
+    atomicSet(&previous->next, node);
+  }
+
+  // Called by the consumer only.
+  JobNode* pop() {
+    JobNode* tail = tail_;
+    JobNode* next = atomicGet(&tail->next);
+    if (tail == &stub_) {
+      if (next == nullptr) return nullptr;
+      tail_ = next;
+      tail = next;
+      next = atomicGet(&next->next);
+    }
+    if (next != nullptr) {
+      tail_ = next;
+      return tail;
+    }
+    // Either the last node, or some producer is not done with it yet.
+    if (tail != atomicGet(&head_)) return nullptr;
+    push(&stub_);
+    next = atomicGet(&tail->next);
+    if (next != nullptr) {
+      tail_ = next;
+      return tail;
+    }
+    return nullptr;
+  }
+
+  // Called by the consumer only.
+  bool empty() {
+    return tail_ == &stub_ && atomicGet(&stub_.next) == nullptr;
+  }
+
+ private:
+  JobNode* volatile head_;
+  JobNode* tail_;
+  JobNode stub_;
 };
 
 class Worker {
  public:
-  Worker(KInt id, bool errorReporting) : id_(id), errorReporting_(errorReporting) {
+  Worker(KInt id, bool errorReporting) : id_(id), errorReporting_(errorReporting), waiting_(0) {
     pthread_mutex_init(&lock_, nullptr);
     pthread_cond_init(&cond_, nullptr);
   }
 
   ~Worker() {
     // Cleanup jobs in queue.
-    for (auto job : queue_) {
-      DisposeStablePointer(job.argument);
-      job.future->cancelUnlocked();
+    while (JobNode* node = nextJob()) {
+      DisposeStablePointer(node->job.argument);
+      node->job.future->cancelUnlocked();
+      konanDestructInstance(node);
     }
 
     pthread_mutex_destroy(&lock_);
     pthread_cond_destroy(&cond_);
   }
 
+  // Jobs put to front are executed before all other jobs, in order of their arrival.
   void putJob(Job job, bool toFront) {
-    Locker locker(&lock_);
-    if (toFront)
-       queue_.push_front(job);
-    else
-       queue_.push_back(job);
-    pthread_cond_signal(&cond_);
+    JobNode* node = konanConstructInstance<JobNode>();
+    node->job = job;
+    (toFront ? priorityQueue_ : queue_).push(node);
+    // Pairs with announcing the wait in getJob(): either the worker sees the job, or we see it waiting.
+    __sync_synchronize();
+    if (atomicGet(&waiting_) != 0) {
+      Locker locker(&lock_);
+      pthread_cond_signal(&cond_);
+    }
   }
 
   Job getJob() {
-    Locker locker(&lock_);
-    while (queue_.size() == 0) {
-      pthread_cond_wait(&cond_, &lock_);
+    JobNode* node = nextJob();
+    if (node == nullptr) {
+      // Use idle time to collect cyclic garbage, instead of doing it while processing the next job.
+      GarbageCollectIdle();
+      // Jobs often come in bursts, so wait a bit before going to sleep.
+      for (int spin = 0; spin < kWorkerSpinCount && node == nullptr; ++spin) {
+        spinPause();
+        node = nextJob();
+      }
     }
-    auto result = queue_.front();
-    queue_.pop_front();
+    if (node == nullptr) {
+      Locker locker(&lock_);
+      atomicSet(&waiting_, 1);
+      while ((node = nextJob()) == nullptr) {
+        pthread_cond_wait(&cond_, &lock_);
+      }
+      atomicSet(&waiting_, 0);
+    }
+    Job result = node->job;
+    konanDestructInstance(node);
     return result;
   }
 
@@ -183,145 +416,418 @@ class Worker {
   bool errorReporting() const { return errorReporting_; }
 
  private:
+  JobNode* nextJob() {
+    JobNode* node = priorityQueue_.pop();
+    return node != nullptr ? node : queue_.pop();
+  }
+
   KInt id_;
-  KStdDeque<Job> queue_;
-  // Lock and condition for waiting on the queue.
+  JobQueue queue_;
+  JobQueue priorityQueue_;
+  // Lock and condition for waiting on the queue, only taken when the worker is idle.
   pthread_mutex_t lock_;
   pthread_cond_t cond_;
   bool errorReporting_;
+  // If the worker sleeps, or is going to, waiting for jobs.
+  volatile KInt waiting_;
 };
 
-class State {
+class WorkerPool;
+
+struct PoolMember {
+  WorkerPool* pool;
+  int index;
+  // Jobs of this member, the owner takes them from the front, others steal from the back.
+  pthread_mutex_t lock;
+  KStdDeque<Job> queue;
+};
+
+THREAD_LOCAL_VARIABLE PoolMember* g_currentPoolMember = nullptr;
+
+// Fixed set of threads executing jobs of the pool. Each thread has its own queue, jobs scheduled from
+// outside of the pool are distributed among them round-robin, and jobs scheduled by the pool's own jobs
+// are put to the queue of the scheduling thread. Thread which runs out of jobs steals them from others,
+// so that uneven jobs do not leave threads idle while there is some work to do.
+class WorkerPool {
  public:
-  State() {
+  WorkerPool(KInt id, int size, bool errorReporting)
+      : id_(id), size_(size), errorReporting_(errorReporting), next_(0), pending_(0), sleepers_(0),
+        terminating_(0), processScheduledJobs_(true), running_(0), terminationFuture_(nullptr) {
     pthread_mutex_init(&lock_, nullptr);
     pthread_cond_init(&cond_, nullptr);
+    members_ = reinterpret_cast<PoolMember*>(konanAllocMemory(sizeof(PoolMember) * size));
+    for (int index = 0; index < size; ++index) {
+      auto* member = new (&members_[index]) PoolMember();
+      member->pool = this;
+      member->index = index;
+      pthread_mutex_init(&member->lock, nullptr);
+    }
+  }
+
+  ~WorkerPool() {
+    for (int index = 0; index < size_; ++index) {
+      auto& member = members_[index];
+      // Cleanup jobs in queue.
+      for (auto job : member.queue) {
+        DisposeStablePointer(job.argument);
+        job.future->cancelUnlocked();
+      }
+      pthread_mutex_destroy(&member.lock);
+      member.~PoolMember();
+    }
+    konanFreeMemory(members_);
+    pthread_mutex_destroy(&lock_);
+    pthread_cond_destroy(&cond_);
+  }
+
+  // Returns number of started threads.
+  int start(void* (*routine)(void*)) {
+    for (int index = 0; index < size_; ++index) {
+      pthread_t thread = 0;
+      if (pthread_create(&thread, nullptr, routine, &members_[index]) != 0) break;
+      pthread_detach(thread);
+      atomicAdd(&running_, 1);
+    }
+    return atomicGet(&running_);
+  }
+
+  // Returns false if termination was already requested, job is not queued then.
+  bool putJob(Job job) {
+    if (atomicGet(&terminating_) != 0) return false;
+    PoolMember* member = g_currentPoolMember;
+    if (member == nullptr || member->pool != this) {
+      uint32_t next = atomicAdd(&next_, 1u);
+      member = &members_[next % size_];
+    }
+    // Counted first, so that idle threads keep looking for the job until it is queued.
+    atomicAdd(&pending_, 1);
+    {
+      Locker locker(&member->lock);
+      member->queue.push_back(job);
+    }
+    // Pairs with going to sleep in getJob(): either the sleeper sees the job, or we see the sleeper.
+    __sync_synchronize();
+    if (atomicGet(&sleepers_) != 0) {
+      Locker locker(&lock_);
+      pthread_cond_signal(&cond_);
+    }
+    return true;
+  }
+
+  void requestTermination(Future* future, bool processScheduledJobs) {
+    {
+      Locker locker(&lock_);
+      terminationFuture_ = future;
+      processScheduledJobs_ = processScheduledJobs;
+      atomicSet(&terminating_, 1);
+      pthread_cond_broadcast(&cond_);
+    }
+  }
+
+  // Returns false once the thread shall terminate.
+  bool getJob(PoolMember* member, Job* job) {
+    bool collected = false;
+    while (true) {
+      if (atomicGet(&terminating_) != 0 && (!processScheduledJobs_ || atomicGet(&pending_) == 0))
+        return false;
+      if (takeJob(member, job)) return true;
+      if (!collected) {
+        // Use idle time to collect cyclic garbage, instead of doing it while processing the next job.
+        GarbageCollectIdle();
+        collected = true;
+        continue;
+      }
+      for (int spin = 0; spin < kWorkerSpinCount && !hasWork(); ++spin) {
+        spinPause();
+      }
+      if (hasWork()) continue;
+      Locker locker(&lock_);
+      atomicAdd(&sleepers_, 1);
+      while (!hasWork()) {
+        pthread_cond_wait(&cond_, &lock_);
+      }
+      atomicAdd(&sleepers_, -1);
+    }
+  }
+
+  // Returns true for the last terminated thread.
+  bool memberTerminated() {
+    return atomicAdd(&running_, -1) == 0;
+  }
+
+  Future* terminationFuture() {
+    Locker locker(&lock_);
+    return terminationFuture_;
+  }
+
+  KInt id() const { return id_; }
+
+  bool errorReporting() const { return errorReporting_; }
+
+ private:
+  bool hasWork() {
+    return atomicGet(&pending_) != 0 || atomicGet(&terminating_) != 0;
+  }
+
+  bool takeJob(PoolMember* member, Job* job) {
+    if (atomicGet(&pending_) == 0) return false;
+    {
+      Locker locker(&member->lock);
+      if (!member->queue.empty()) {
+        *job = member->queue.front();
+        member->queue.pop_front();
+        atomicAdd(&pending_, -1);
+        return true;
+      }
+    }
+    for (int step = 1; step < size_; ++step) {
+      auto& victim = members_[(member->index + step) % size_];
+      // Busy victim is likely to have its jobs stolen by someone else.
+      if (pthread_mutex_trylock(&victim.lock) != 0) continue;
+      bool stolen = !victim.queue.empty();
+      if (stolen) {
+        *job = victim.queue.back();
+        victim.queue.pop_back();
+        atomicAdd(&pending_, -1);
+      }
+      pthread_mutex_unlock(&victim.lock);
+      if (stolen) return true;
+    }
+    return false;
+  }
+
+  KInt id_;
+  int size_;
+  bool errorReporting_;
+  PoolMember* members_;
+  // Round-robin counter for jobs scheduled from outside of the pool.
+  volatile uint32_t next_;
+  // Number of jobs in all queues.
+  volatile KInt pending_;
+  // Number of threads sleeping, or going to, waiting for jobs.
+  volatile KInt sleepers_;
+  volatile KInt terminating_;
+  bool processScheduledJobs_;
+  // Number of threads not yet terminated.
+  volatile KInt running_;
+  Future* terminationFuture_;
+  // Lock and condition for waiting for jobs, only taken by idle threads and to wake them up.
+  pthread_mutex_t lock_;
+  pthread_cond_t cond_;
+};
+
+// Futures are spread over shards by their id, so that threads working with different futures
+// do not contend on a single lock. Ids are allocated without locking.
+class FutureRegistry {
+ public:
+  FutureRegistry() : currentFutureId_(0) {
+    for (int index = 0; index < kFutureShards; ++index)
+      pthread_mutex_init(&shards_[index].lock, nullptr);
+  }
+
+  ~FutureRegistry() {
+    for (int index = 0; index < kFutureShards; ++index)
+      pthread_mutex_destroy(&shards_[index].lock);
+  }
+
+  Future* add() {
+    Future* future = konanConstructInstance<Future>(atomicAdd(&currentFutureId_, 1));
+    Shard& shard = shardOf(future->id());
+    Locker locker(&shard.lock);
+    shard.futures[future->id()] = future;
+    return future;
+  }
+
+  KInt stateOf(KInt id) {
+    Shard& shard = shardOf(id);
+    Locker locker(&shard.lock);
+    auto it = shard.futures.find(id);
+    if (it == shard.futures.end()) return INVALID;
+    return it->second->state();
+  }
+
+  Future* find(KInt id) {
+    Shard& shard = shardOf(id);
+    Locker locker(&shard.lock);
+    auto it = shard.futures.find(id);
+    return it == shard.futures.end() ? nullptr : it->second;
+  }
+
+  // Future may only be used with the shard lock taken, as otherwise it may be consumed and disposed.
+  // Returns false if future is completed or consumed already.
+  bool addWaiter(KInt id, FutureWaiter* waiter) {
+    Shard& shard = shardOf(id);
+    Locker locker(&shard.lock);
+    auto it = shard.futures.find(id);
+    return it != shard.futures.end() && it->second->addWaiterUnlocked(waiter);
+  }
+
+  void removeWaiter(KInt id, FutureWaiter* waiter) {
+    Shard& shard = shardOf(id);
+    Locker locker(&shard.lock);
+    auto it = shard.futures.find(id);
+    if (it != shard.futures.end()) it->second->removeWaiterUnlocked(waiter);
+  }
+
+  // Returns false if future was already removed.
+  bool remove(KInt id) {
+    Shard& shard = shardOf(id);
+    Locker locker(&shard.lock);
+    return shard.futures.erase(id) != 0;
+  }
+
+ private:
+  // Must be a power of two.
+  static constexpr int kFutureShards = 64;
+
+  struct Shard {
+    pthread_mutex_t lock;
+    KStdUnorderedMap<KInt, Future*> futures;
+  };
+
+  Shard& shardOf(KInt id) {
+    return shards_[static_cast<uint32_t>(id) & (kFutureShards - 1)];
+  }
+
+  Shard shards_[kFutureShards];
+  volatile KInt currentFutureId_;
+};
+
+class State {
+ public:
+  State() {
+    pthread_rwlock_init(&workersLock_, nullptr);
 
     currentWorkerId_ = 1;
-    currentFutureId_ = 1;
-    currentVersion_ = 0;
   }
 
   ~State() {
     // TODO: some sanity check here?
-    pthread_mutex_destroy(&lock_);
-    pthread_cond_destroy(&cond_);
+    pthread_rwlock_destroy(&workersLock_);
   }
 
   Worker* addWorkerUnlocked(bool errorReporting) {
-    Locker locker(&lock_);
+    WriteLocker locker(&workersLock_);
     Worker* worker = konanConstructInstance<Worker>(nextWorkerId(), errorReporting);
     if (worker == nullptr) return nullptr;
     workers_[worker->id()] = worker;
     return worker;
   }
 
+  WorkerPool* addPoolUnlocked(int size, bool errorReporting) {
+    WriteLocker locker(&workersLock_);
+    WorkerPool* pool = konanConstructInstance<WorkerPool>(nextWorkerId(), size, errorReporting);
+    if (pool == nullptr) return nullptr;
+    pools_[pool->id()] = pool;
+    return pool;
+  }
+
+  void removePoolUnlocked(KInt id) {
+    WriteLocker locker(&workersLock_);
+    pools_.erase(id);
+  }
+
+  // Pool accepts no jobs once termination is requested.
+  Future* terminatePoolUnlocked(KInt id, bool processScheduledJobs) {
+    Future* future = nullptr;
+    WorkerPool* pool = nullptr;
+    {
+      WriteLocker locker(&workersLock_);
+      auto it = pools_.find(id);
+      if (it == pools_.end()) return nullptr;
+      pool = it->second;
+      pools_.erase(it);
+    }
+    future = futures_.add();
+    pool->requestTermination(future, processScheduledJobs);
+    return future;
+  }
+
   void removeWorkerUnlocked(KInt id) {
-    Locker locker(&lock_);
+    WriteLocker locker(&workersLock_);
     auto it = workers_.find(id);
     if (it == workers_.end()) return;
     workers_.erase(it);
   }
 
   Future* addJobToWorkerUnlocked(
-      KInt id, KNativePtr jobFunction, KNativePtr jobArgument, bool toFront, KInt transferMode) {
-    Future* future = nullptr;
-    Worker* worker = nullptr;
-    {
-      Locker locker(&lock_);
+      KInt id, KNativePtr jobFunction, KNativePtr jobArgument, bool toFront, KInt transferMode, bool batch) {
+    // Lock is held until the job is queued, as terminated pool could be disposed otherwise.
+    ReadLocker locker(&workersLock_);
 
-      auto it = workers_.find(id);
-      if (it == workers_.end()) return nullptr;
+    Worker* worker = nullptr;
+    WorkerPool* pool = nullptr;
+    auto it = workers_.find(id);
+    if (it != workers_.end()) {
       worker = it->second;
-
-      future = konanConstructInstance<Future>(nextFutureId());
-      futures_[future->id()] = future;
+    } else {
+      // Pools share id space with workers, and are scheduled to the same way.
+      auto poolIt = pools_.find(id);
+      if (poolIt == pools_.end()) return nullptr;
+      pool = poolIt->second;
     }
+    Future* future = futures_.add();
 
     Job job;
     job.function = reinterpret_cast<KRef (*)(KRef, ObjHeader**)>(jobFunction);
     job.argument = jobArgument;
     job.future = future;
     job.transferMode = transferMode;
+    job.batch = batch;
 
-    worker->putJob(job, toFront);
+    if (worker != nullptr) {
+      worker->putJob(job, toFront);
+    } else if (!pool->putJob(job)) {
+      DisposeStablePointer(job.argument);
+      future->cancelUnlocked();
+    }
 
     return future;
   }
 
   KInt stateOfFutureUnlocked(KInt id) {
-    Locker locker(&lock_);
-    auto it = futures_.find(id);
-    if (it == futures_.end()) return INVALID;
-    return it->second->state();
+    return futures_.stateOf(id);
   }
 
   OBJ_GETTER(consumeFutureUnlocked, KInt id) {
-    Future* future = nullptr;
-    {
-      Locker locker(&lock_);
-      auto it = futures_.find(id);
-      if (it == futures_.end()) ThrowWorkerInvalidState();
-      future = it->second;
-    }
+    Future* future = futures_.find(id);
+    if (future == nullptr) ThrowWorkerInvalidState();
 
     KRef result = future->consumeResultUnlocked(OBJ_RESULT);
 
-    {
-       Locker locker(&lock_);
-       auto it = futures_.find(id);
-       if (it != futures_.end()) {
-         futures_.erase(it);
-         konanDestructInstance(future);
-       }
-    }
+    if (futures_.remove(id))
+      konanDestructInstance(future);
 
     return result;
   }
 
-  KBoolean waitForAnyFuture(KInt version, KInt millis) {
-    Locker locker(&lock_);
-    if (version != currentVersion_) return false;
-
-    if (millis < 0) {
-      pthread_cond_wait(&cond_, &lock_);
-      return true;
-    }
-    struct timeval tv;
-    struct timespec ts;
-    gettimeofday(&tv, nullptr);
-    KLong nsDelta = millis * 1000000LL;
-    ts.tv_nsec = (tv.tv_usec * 1000LL + nsDelta) % 1000000000LL;
-    ts.tv_sec =  (tv.tv_sec * 1000000000LL + nsDelta) / 1000000000LL;
-    pthread_cond_timedwait(&cond_, &lock_, &ts);
-    return true;
-  }
-
-  void signalAnyFuture() {
-    {
-      Locker locker(&lock_);
-      currentVersion_++;
+  // Only wakes up the caller once any of the given futures is completed, or once the deadline has passed.
+  KBoolean waitForFutures(const KInt* ids, KInt count, KLong deadlineNanos) {
+    FutureWaiter waiter;
+    KInt registered = 0;
+    bool completed = false;
+    for (; registered < count; ++registered) {
+      if (!futures_.addWaiter(ids[registered], &waiter)) {
+        completed = true;
+        break;
+      }
     }
-    pthread_cond_broadcast(&cond_);
-  }
-
-  KInt versionToken() {
-    Locker locker(&lock_);
-    return currentVersion_;
+    if (!completed) completed = waiter.wait(deadlineNanos);
+    for (KInt index = 0; index < registered; ++index)
+      futures_.removeWaiter(ids[index], &waiter);
+    return completed;
   }
 
-  // All those called with lock taken.
+  // Called with workers lock taken for writing.
   KInt nextWorkerId() { return currentWorkerId_++; }
-  KInt nextFutureId() { return currentFutureId_++; }
 
  private:
-  pthread_mutex_t lock_;
-  pthread_cond_t cond_;
-  KStdUnorderedMap<KInt, Future*> futures_;
+  FutureRegistry futures_;
+  // Guards workers and pools, which are mostly looked up to schedule jobs.
+  pthread_rwlock_t workersLock_;
   KStdUnorderedMap<KInt, Worker*> workers_;
+  KStdUnorderedMap<KInt, WorkerPool*> pools_;
   KInt currentWorkerId_;
-  KInt currentFutureId_;
-  KInt currentVersion_;
 };
 
 State* theState() {
@@ -351,8 +857,8 @@ void Future::storeResultUnlocked(KNativePtr result, bool ok) {
     // of the taken lock, it's not on macOS (as of 10.13.1). If moved outside of the lock,
     // some notifications are missing.
     pthread_cond_signal(&cond_);
+    signalWaiters();
   }
-  theState()->signalAnyFuture();
 }
 
 void Future::cancelUnlocked() {
@@ -361,13 +867,57 @@ void Future::cancelUnlocked() {
     state_ = CANCELLED;
     result_ = nullptr;
     pthread_cond_signal(&cond_);
+    signalWaiters();
   }
-  theState()->signalAnyFuture();
 }
 
 // Defined in RuntimeUtils.kt.
 extern "C" void ReportUnhandledException(KRef e);
 
+// Applies job function to each element of the arguments array, releasing them, and collects the results.
+void runBatch(const Job& job, KRef arguments, KRef* resultRef) {
+  ArrayHeader* array = arguments->array();
+  ArrayHeader* results = AllocArrayInstance(theArrayTypeInfo, array->count_, resultRef)->array();
+  try {
+    for (uint32_t index = 0; index < array->count_; ++index) {
+      ObjHolder holder;
+      KRef* argument = ArrayAddressOfElementAt(array, index);
+      job.function(*argument, holder.slot());
+      UpdateRef(argument, nullptr);
+      UpdateRef(ArrayAddressOfElementAt(results, index), holder.obj());
+    }
+  } catch (ObjHolder& e) {
+    UpdateRef(resultRef, nullptr);
+    throw;
+  }
+}
+
+void runJob(const Job& job, bool errorReporting) {
+  ObjHolder argumentHolder;
+  KRef argument = AdoptStablePointer(job.argument, argumentHolder.slot());
+  // Note that this is a bit hacky, as we must not auto-release resultRef,
+  // so we don't use ObjHolder.
+  // It is so, as ownership is transferred.
+  KRef resultRef = nullptr;
+  KNativePtr result = nullptr;
+  bool ok = true;
+  try {
+      if (job.batch)
+        runBatch(job, argument, &resultRef);
+      else
+        job.function(argument, &resultRef);
+      argumentHolder.clear();
+      // Transfer the result.
+      result = transfer(resultRef, job.transferMode);
+  } catch (ObjHolder& e) {
+      ok = false;
+      if (errorReporting)
+          ReportUnhandledException(e.obj());
+  }
+  // Notify the future.
+  job.future->storeResultUnlocked(result, ok);
+}
+
 void* workerRoutine(void* argument) {
   Worker* worker = reinterpret_cast<Worker*>(argument);
 
@@ -382,26 +932,7 @@ void* workerRoutine(void* argument) {
       theState()->removeWorkerUnlocked(worker->id());
       break;
     }
-    ObjHolder argumentHolder;
-    KRef argument = AdoptStablePointer(job.argument, argumentHolder.slot());
-    // Note that this is a bit hacky, as we must not auto-release resultRef,
-    // so we don't use ObjHolder.
-    // It is so, as ownership is transferred.
-    KRef resultRef = nullptr;
-    KNativePtr result = nullptr;
-    bool ok = true;
-    try {
-        job.function(argument, &resultRef);
-        argumentHolder.clear();
-        // Transfer the result.
-        result = transfer(resultRef, job.transferMode);
-    } catch (ObjHolder& e) {
-        ok = false;
-        if (worker->errorReporting())
-            ReportUnhandledException(e.obj());
-    }
-    // Notify the future.
-    job.future->storeResultUnlocked(result, ok);
+    runJob(job, worker->errorReporting());
   }
 
   Kotlin_deinitRuntimeIfNeeded();
@@ -411,6 +942,31 @@ void* workerRoutine(void* argument) {
   return nullptr;
 }
 
+void* poolMemberRoutine(void* argument) {
+  PoolMember* member = reinterpret_cast<PoolMember*>(argument);
+  WorkerPool* pool = member->pool;
+
+  g_currentPoolMember = member;
+  Kotlin_initRuntimeIfNeeded();
+
+  Job job;
+  while (pool->getJob(member, &job)) {
+    runJob(job, pool->errorReporting());
+  }
+
+  Kotlin_deinitRuntimeIfNeeded();
+  g_currentPoolMember = nullptr;
+
+  // The last terminated thread disposes the pool, cancelling jobs left, and notifies the future.
+  if (pool->memberTerminated()) {
+    Future* future = pool->terminationFuture();
+    konanDestructInstance(pool);
+    if (future != nullptr) future->storeResultUnlocked(nullptr, true);
+  }
+
+  return nullptr;
+}
+
 KInt startWorker(KBoolean errorReporting) {
   Worker* worker = theState()->addWorkerUnlocked(errorReporting != 0);
   if (worker == nullptr) return -1;
@@ -423,14 +979,63 @@ KInt currentWorker() {
   return g_currentWorkerId;
 }
 
+KInt startPool(KInt size, KBoolean errorReporting) {
+  WorkerPool* pool = theState()->addPoolUnlocked(size, errorReporting != 0);
+  if (pool == nullptr) return -1;
+  int started = pool->start(poolMemberRoutine);
+  if (started == size) return pool->id();
+  theState()->removePoolUnlocked(pool->id());
+  if (started == 0)
+    konanDestructInstance(pool);
+  else
+    // Started threads terminate and dispose the pool.
+    pool->requestTermination(nullptr, false);
+  return -1;
+}
+
+KInt requestPoolTermination(KInt id, KBoolean processScheduledJobs) {
+  Future* future = theState()->terminatePoolUnlocked(id, processScheduledJobs != 0);
+  if (future == nullptr) ThrowWorkerInvalidState();
+  return future->id();
+}
+
 KInt schedule(KInt id, KInt transferMode, KRef producer, KNativePtr jobFunction) {
   Job job;
   // Note that this is a bit hacky, as we must not auto-release jobArgumentRef,
   // so we don't use ObjHolder.
   KRef jobArgumentRef = nullptr;
-  WorkerLaunchpad(producer, &jobArgumentRef);
-  KNativePtr jobArgument = transfer(jobArgumentRef, transferMode);
-  Future* future = theState()->addJobToWorkerUnlocked(id, jobFunction, jobArgument, false, transferMode);
+  KNativePtr jobArgument;
+  {
+    ArenaScope scope(transferMode);
+    WorkerLaunchpad(producer, &jobArgumentRef);
+    jobArgument = transfer(jobArgumentRef, transferMode, scope.arena());
+  }
+  Future* future = theState()->addJobToWorkerUnlocked(id, jobFunction, jobArgument, false, transferMode, false);
+  if (future == nullptr) ThrowWorkerInvalidState();
+  return future->id();
+}
+
+KInt scheduleBatch(KInt id, KInt transferMode, KInt count, KRef producer, KNativePtr jobFunction) {
+  // Arguments of all jobs are collected into a single array, so they are transferred at once.
+  // As in schedule(), argumentsRef is not auto-released, as ownership is transferred.
+  KRef argumentsRef = nullptr;
+  KNativePtr jobArgument;
+  {
+    ArenaScope scope(transferMode);
+    ArrayHeader* arguments = AllocArrayInstance(theArrayTypeInfo, count, &argumentsRef)->array();
+    try {
+      for (KInt index = 0; index < count; ++index) {
+        ObjHolder holder;
+        WorkerBatchLaunchpad(producer, index, holder.slot());
+        UpdateRef(ArrayAddressOfElementAt(arguments, index), holder.obj());
+      }
+    } catch (ObjHolder& e) {
+      UpdateRef(&argumentsRef, nullptr);
+      throw;
+    }
+    jobArgument = transfer(argumentsRef, transferMode, scope.arena());
+  }
+  Future* future = theState()->addJobToWorkerUnlocked(id, jobFunction, jobArgument, false, transferMode, true);
   if (future == nullptr) ThrowWorkerInvalidState();
   return future->id();
 }
@@ -445,17 +1050,18 @@ OBJ_GETTER(consumeFuture, KInt id) {
 
 KInt requestTermination(KInt id, KBoolean processScheduledJobs) {
   Future* future = theState()->addJobToWorkerUnlocked(
-      id, nullptr, nullptr, /* toFront = */ !processScheduledJobs, UNCHECKED);
+      id, nullptr, nullptr, /* toFront = */ !processScheduledJobs, UNCHECKED, false);
   if (future == nullptr) ThrowWorkerInvalidState();
   return future->id();
 }
 
-KBoolean waitForAnyFuture(KInt version, KInt millis) {
-  return theState()->waitForAnyFuture(version, millis);
+KLong monotonicDeadline(KInt timeoutMillis) {
+  return timeoutMillis < 0 ? -1 : monotonicNanos() + timeoutMillis * 1000000LL;
 }
 
-KInt versionToken() {
-  return theState()->versionToken();
+KBoolean waitForFutures(KRef ids, KLong deadlineNanos) {
+  ArrayHeader* array = ids->array();
+  return theState()->waitForFutures(AddressOfElementAt<KInt>(array, 0), array->count_, deadlineNanos);
 }
 
 OBJ_GETTER(attachObjectGraphInternal, KNativePtr stable) {
@@ -463,10 +1069,11 @@ OBJ_GETTER(attachObjectGraphInternal, KNativePtr stable) {
 }
 
 KNativePtr detachObjectGraphInternal(KInt transferMode, KRef producer) {
+   ArenaScope scope(transferMode);
    KRef ref = nullptr;
    WorkerLaunchpad(producer, &ref);
    if (ref != nullptr) {
-     return transfer(ref, transferMode);
+     return transfer(ref, transferMode, scope.arena());
    } else
      return nullptr;
 }
@@ -488,11 +1095,26 @@ KInt schedule(KInt id, KInt transferMode, KRef producer, KNativePtr jobFunction)
   return 0;
 }
 
+KInt scheduleBatch(KInt id, KInt transferMode, KInt count, KRef producer, KNativePtr jobFunction) {
+  ThrowWorkerUnsupported();
+  return 0;
+}
+
 KInt currentWorker() {
   ThrowWorkerUnsupported();
   return 0;
 }
 
+KInt startPool(KInt size, KBoolean errorReporting) {
+  ThrowWorkerUnsupported();
+  return -1;
+}
+
+KInt requestPoolTermination(KInt id, KBoolean processScheduledJobs) {
+  ThrowWorkerUnsupported();
+  return -1;
+}
+
 OBJ_GETTER(consumeFuture, KInt id) {
   ThrowWorkerUnsupported();
   RETURN_OBJ(nullptr);
@@ -503,14 +1125,14 @@ KInt requestTermination(KInt id, KBoolean processScheduledJobs) {
   return -1;
 }
 
-KBoolean waitForAnyFuture(KInt versionToken, KInt millis) {
+KLong monotonicDeadline(KInt timeoutMillis) {
   ThrowWorkerUnsupported();
-  return false;
+  return -1;
 }
 
-KInt versionToken() {
+KBoolean waitForFutures(KRef ids, KLong deadlineNanos) {
   ThrowWorkerUnsupported();
-  return 0;
+  return false;
 }
 
 OBJ_GETTER(attachObjectGraphInternal, KNativePtr stable) {
@@ -541,10 +1163,22 @@ KInt Kotlin_Worker_requestTerminationWorkerInternal(KInt id, KBoolean processSch
     return requestTermination(id, processScheduledJobs);
 }
 
+KInt Kotlin_WorkerPool_startInternal(KInt size, KBoolean errorReporting) {
+  return startPool(size, errorReporting);
+}
+
+KInt Kotlin_WorkerPool_requestTerminationInternal(KInt id, KBoolean processScheduledJobs) {
+  return requestPoolTermination(id, processScheduledJobs);
+}
+
 KInt Kotlin_Worker_executeInternal(KInt id, KInt transferMode, KRef producer, KNativePtr job) {
   return schedule(id, transferMode, producer, job);
 }
 
+KInt Kotlin_Worker_executeBatchInternal(KInt id, KInt transferMode, KInt count, KRef producer, KNativePtr job) {
+  return scheduleBatch(id, transferMode, count, producer, job);
+}
+
 KInt Kotlin_Worker_stateOfFuture(KInt id) {
   return stateOfFuture(id);
 }
@@ -553,12 +1187,12 @@ OBJ_GETTER(Kotlin_Worker_consumeFuture, KInt id) {
   RETURN_RESULT_OF(consumeFuture, id);
 }
 
-KBoolean Kotlin_Worker_waitForAnyFuture(KInt versionToken, KInt millis) {
-  return waitForAnyFuture(versionToken, millis);
+KLong Kotlin_Worker_monotonicDeadline(KInt timeoutMillis) {
+  return monotonicDeadline(timeoutMillis);
 }
 
-KInt Kotlin_Worker_versionToken() {
-  return versionToken();
+KBoolean Kotlin_Worker_waitForFutures(KRef ids, KLong deadlineNanos) {
+  return waitForFutures(ids, deadlineNanos);
 }
 
 OBJ_GETTER(Kotlin_Worker_attachObjectGraphInternal, KNativePtr stable) {
@@ -574,6 +1208,13 @@ void Kotlin_Worker_freezeInternal(KRef object) {
     FreezeSubgraph(object);
 }
 
+OBJ_GETTER(Kotlin_Worker_buildFrozenInternal, KRef producer) {
+  ArenaScope scope(ARENA);
+  KRef result = WorkerLaunchpad(producer, OBJ_RESULT);
+  FreezeArenaSubgraph(scope.arena(), result);
+  return *OBJ_RESULT;
+}
+
 KBoolean Kotlin_Worker_isFrozenInternal(KRef object) {
   return object == nullptr || PermanentOrFrozen(object);
 }
@@ -68,6 +68,38 @@ public inline class Future<T> @PublishedApi internal constructor(val id: Int) {
     override public fun toString(): String = "future $id"
 }
 
+/**
+ * Results of a batch of jobs scheduled with `executeBatch`, which become available all together.
+ */
+@Suppress("NON_PUBLIC_PRIMARY_CONSTRUCTOR_OF_INLINE_CLASS")
+public inline class FutureGroup<T> @PublishedApi internal constructor(val id: Int) {
+    /**
+     * Blocks execution until all jobs of the batch are done.
+     *
+     * @return the execution result of [code] called with results of the jobs, in the order of the batch
+     * @throws IllegalStateException if the group is in [FutureState.INVALID], [FutureState.CANCELLED] or
+     * [FutureState.THROWN] state
+     */
+    public inline fun <R> consume(code: (List<T>) -> R): R =
+            @Suppress("UNCHECKED_CAST")
+            code((Future<Array<Any?>>(id).result as Array<T>).asList())
+
+    /**
+     * Results of all jobs of the batch, in the order of the batch.
+     * Blocks execution until they are ready. Second attempt to get will result in an error.
+     */
+    public val results: List<T>
+            get() = consume { it -> it }
+
+    /**
+     * A [FutureState] of the whole batch
+     */
+    public val state: FutureState
+        get() = Future<Any?>(id).state
+
+    override public fun toString(): String = "future group $id"
+}
+
 
 @Deprecated("Use 'waitForMultipleFutures' top-level function instead", ReplaceWith("waitForMultipleFutures(this, millis)"), DeprecationLevel.ERROR)
 public fun <T> Collection<Future<T>>.waitForMultipleFutures(millis: Int): Set<Future<T>> = waitForMultipleFutures(this, millis)
@@ -76,22 +108,30 @@ public fun <T> Collection<Future<T>>.waitForMultipleFutures(millis: Int): Set<Fu
 /**
  * Wait for availability of futures in the collection. Returns set with all futures which have
  * value available for the consumption, i.e. [FutureState.COMPUTED].
+ * Only the calling thread is woken up once any of these futures is computed, so that threads waiting
+ * for different futures do not disturb each other.
  *
- * @param timeoutMillis the amount of time in milliseconds to wait for the computed future
+ * @param timeoutMillis the amount of time in milliseconds to wait for the computed future,
+ * or negative value to wait without timeout
  */
 public fun <T> waitForMultipleFutures(futures: Collection<Future<T>>, timeoutMillis: Int): Set<Future<T>> {
     val result = mutableSetOf<Future<T>>()
+    val scheduled = IntArray(futures.size)
+    val deadline = monotonicDeadline(timeoutMillis)
 
     while (true) {
-        val versionToken = versionToken()
+        var scheduledCount = 0
         for (future in futures) {
-            if (future.state == FutureState.COMPUTED) {
-                result += future
+            when (future.state) {
+                FutureState.COMPUTED -> result += future
+                FutureState.SCHEDULED -> scheduled[scheduledCount++] = future.id
+                else -> {}
             }
         }
-        if (result.isNotEmpty()) return result
+        if (result.isNotEmpty() || scheduledCount == 0) return result
 
-        if (waitForAnyFuture(versionToken, timeoutMillis)) break
+        // Cancelled or failed futures also wake us up, then wait for the rest of them until the same deadline.
+        if (!waitForFutures(scheduled.copyOf(scheduledCount), deadline)) break
     }
 
     for (future in futures) {
@@ -101,4 +141,4 @@ public fun <T> waitForMultipleFutures(futures: Collection<Future<T>>, timeoutMil
     }
 
     return result
-}
\ No newline at end of file
+}
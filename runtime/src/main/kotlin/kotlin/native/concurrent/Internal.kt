@@ -18,16 +18,27 @@ external internal fun stateOfFuture(id: Int): Int
 @PublishedApi
 external internal fun consumeFuture(id: Int): Any?
 
-@SymbolName("Kotlin_Worker_waitForAnyFuture")
-external internal fun waitForAnyFuture(versionToken: Int, millis: Int): Boolean
+// Deadline for waitForFutures() in nanoseconds of the monotonic clock, or -1 for negative timeout.
+@SymbolName("Kotlin_Worker_monotonicDeadline")
+external internal fun monotonicDeadline(timeoutMillis: Int): Long
 
-@SymbolName("Kotlin_Worker_versionToken")
-external internal fun versionToken(): Int
+// Returns once any of futures with given ids is not scheduled anymore, or false once the deadline has passed.
+@SymbolName("Kotlin_Worker_waitForFutures")
+external internal fun waitForFutures(ids: IntArray, deadlineNanos: Long): Boolean
 
+// `id` is the id of either worker or worker pool.
 @kotlin.native.internal.ExportForCompiler
-internal fun executeImpl(worker: Worker, mode: TransferMode, producer: () -> Any?,
+internal fun executeImpl(id: Int, mode: TransferMode, producer: () -> Any?,
                          job: CPointer<CFunction<*>>): Future<Any?> =
-        Future<Any?>(executeInternal(worker.id, mode.value, producer, job))
+        Future<Any?>(executeInternal(id, mode.value, producer, job))
+
+// `producer` is called with index of each job in the batch, and `job` is called with each produced value.
+@kotlin.native.internal.ExportForCompiler
+internal fun executeBatchImpl(id: Int, mode: TransferMode, count: Int, producer: (Int) -> Any?,
+                              job: CPointer<CFunction<*>>): FutureGroup<Any?> {
+    if (count < 0) throw IllegalArgumentException("Negative batch size: $count")
+    return FutureGroup<Any?>(executeBatchInternal(id, mode.value, count, producer, job))
+}
 
 @SymbolName("Kotlin_Worker_startInternal")
 external internal fun startInternal(errorReporting: Boolean): Int
@@ -38,10 +49,20 @@ external internal fun currentInternal(): Int
 @SymbolName("Kotlin_Worker_requestTerminationWorkerInternal")
 external internal fun requestTerminationInternal(id: Int, processScheduledJobs: Boolean): Int
 
+@SymbolName("Kotlin_WorkerPool_startInternal")
+external internal fun startPoolInternal(size: Int, errorReporting: Boolean): Int
+
+@SymbolName("Kotlin_WorkerPool_requestTerminationInternal")
+external internal fun requestPoolTerminationInternal(id: Int, processScheduledJobs: Boolean): Int
+
 @SymbolName("Kotlin_Worker_executeInternal")
 external internal fun executeInternal(
         id: Int, mode: Int, producer: () -> Any?, job: CPointer<CFunction<*>>): Int
 
+@SymbolName("Kotlin_Worker_executeBatchInternal")
+external internal fun executeBatchInternal(
+        id: Int, mode: Int, count: Int, producer: (Int) -> Any?, job: CPointer<CFunction<*>>): Int
+
 @ExportForCppRuntime
 internal fun ThrowWorkerUnsupported(): Unit =
         throw UnsupportedOperationException("Workers are not supported")
@@ -53,6 +74,9 @@ internal fun ThrowWorkerInvalidState(): Unit =
 @ExportForCppRuntime
 internal fun WorkerLaunchpad(function: () -> Any?) = function()
 
+@ExportForCppRuntime
+internal fun WorkerBatchLaunchpad(function: (Int) -> Any?, index: Int) = function(index)
+
 @PublishedApi
 @SymbolName("Kotlin_Worker_detachObjectGraphInternal")
 external internal fun detachObjectGraphInternal(mode: Int, producer: () -> Any?): NativePtr
@@ -64,6 +88,9 @@ external internal fun attachObjectGraphInternal(stable: NativePtr): Any?
 @SymbolName("Kotlin_Worker_freezeInternal")
 internal external fun freezeInternal(it: Any?)
 
+@SymbolName("Kotlin_Worker_buildFrozenInternal")
+internal external fun buildFrozenInternal(producer: () -> Any?): Any?
+
 @SymbolName("Kotlin_Worker_isFrozenInternal")
 internal external fun isFrozenInternal(it: Any?): Boolean
 
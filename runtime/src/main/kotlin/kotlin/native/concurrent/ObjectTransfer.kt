@@ -11,12 +11,14 @@ import kotlin.native.internal.Frozen
 /**
  *  ## Object Transfer Basics.
  *
- *  Objects can be passed between threads in one of two possible modes.
+ *  Objects can be passed between threads in one of three possible modes.
  *
  *  - [SAFE] - object subgraph is checked to be not reachable by other globals or locals, and passed
  *      if so, otherwise an exception is thrown
  *  - [UNSAFE] - object is blindly passed to another worker, if there are references
  *      left in the passing worker - it may lead to crash or program malfunction
+ *  - [ARENA] - same as [SAFE], but objects allocated while producing the passed object are placed
+ *      in a transfer arena, so that the check only traverses objects allocated there
  *
  *   Safe mode checks if object is no longer used in passing worker, using memory-management
  *  specific algorithm (ARC implementation relies on trial deletion on object graph rooted in
@@ -27,6 +29,13 @@ import kotlin.native.internal.Frozen
  *  is expected to be correct (such as application debugged earlier in [SAFE] mode), just transfers
  *  ownership without further checks.
  *
+ *   Arena mode is intended for big object graphs built right before the transfer, such as parsed messages.
+ *  Objects allocated by the producer are placed in memory of their own, so that the transferred graph
+ *  is checked without traversing the rest of the heap. If the graph refers to objects allocated elsewhere,
+ *  they are checked as in [SAFE] mode, and so is the result of a job. Note that arena memory is allocated
+ *  in chunks, and a chunk is released only once all objects allocated there are freed, so temporary objects
+ *  of the producer could be kept as long as the transferred objects next to them.
+ *
  *   Note, that for some cases cycle collection need to be done to ensure that dead cycles do not affect
  *  reachability of passed object graph.
  *
@@ -41,7 +50,11 @@ public enum class TransferMode(val value: Int) {
      * Skip reachibility check, can lead to mysterious crashes in an application.
      * USE UNSAFE MODE ONLY IF ABSOLUTELY SURE WHAT YOU'RE DOING!!!
      */
-    UNSAFE(1)
+    UNSAFE(1),
+    /**
+     * Reachibility check is performed, objects allocated by the producer are placed in a transfer arena.
+     */
+    ARENA(2)
 }
 
 /**
@@ -83,7 +83,29 @@ public inline class Worker @PublishedApi internal constructor(val id: Int) {
     public fun <T1, T2> execute(mode: TransferMode, producer: () -> T1, @VolatileLambda job: (T1) -> T2): Future<T2> =
             /*
              * This function is a magical operation, handled by lowering in the compiler, and replaced with call to
-             *   executeImpl(worker, mode, producer, job)
+             *   executeImpl(worker.id, mode, producer, job)
+             * but first ensuring that `job` parameter  doesn't capture any state.
+             */
+            throw RuntimeException("Shall not be called directly")
+
+    /**
+     * Plan batch of [count] jobs for further execution in the worker, which is cheaper than [execute] called
+     * [count] times, as the whole batch is transferred, queued and completed at once.
+     * [producer] is called with index of each job in the batch, and all produced objects together must form
+     * an isolated object subgraph, if in checked mode. Then [job] is called with each of them in the order of
+     * indices, and the results are transferred back together once all jobs of the batch are done.
+     * If any job throws, the rest of the batch is not executed, and the group is in [FutureState.THROWN] state.
+     * Same as for [execute], [job] must not capture any state.
+     *
+     * @return the future group with the results of all jobs in the batch
+     */
+    @Suppress("UNUSED_PARAMETER")
+    @TypedIntrinsic(IntrinsicType.WORKER_EXECUTE_BATCH)
+    public fun <T1, T2> executeBatch(mode: TransferMode, count: Int, producer: (Int) -> T1,
+                                     @VolatileLambda job: (T1) -> T2): FutureGroup<T2> =
+            /*
+             * This function is a magical operation, handled by lowering in the compiler, and replaced with call to
+             *   executeBatchImpl(worker.id, mode, count, producer, job)
              * but first ensuring that `job` parameter  doesn't capture any state.
              */
             throw RuntimeException("Shall not be called directly")
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2010-2018 JetBrains s.r.o. Use of this source code is governed by the Apache 2.0 license
+ * that can be found in the LICENSE file.
+ */
+
+package kotlin.native.concurrent
+
+import kotlin.native.internal.VolatileLambda
+import kotlin.native.internal.IntrinsicType
+import kotlin.native.internal.TypedIntrinsic
+
+/**
+ * Fixed size pool of threads executing jobs, with the same job semantics as [Worker].
+ *
+ * Jobs are not bound to a particular thread: each thread has its own queue of jobs, and threads having
+ * no jobs left steal them from others, so that uneven jobs keep all threads busy. Jobs scheduled from
+ * outside of the pool are distributed among threads, jobs scheduled by jobs of the pool are first queued
+ * to the thread which scheduled them. Note that there is no ordering between jobs of the pool.
+ */
+@Suppress("NON_PUBLIC_PRIMARY_CONSTRUCTOR_OF_INLINE_CLASS")
+public inline class WorkerPool @PublishedApi internal constructor(val id: Int) {
+    companion object {
+        /**
+         * Start new pool of [size] threads, accepting new jobs via `execute` interface.
+         *
+         * @param errorReporting controls if an uncaught exceptions in jobs will be printed out
+         */
+        public fun start(size: Int, errorReporting: Boolean = true): WorkerPool {
+            if (size <= 0) throw IllegalArgumentException("Pool size must be positive: $size")
+            val id = startPoolInternal(size, errorReporting)
+            if (id < 0) throw IllegalStateException("Cannot start $size threads")
+            return WorkerPool(id)
+        }
+    }
+
+    /**
+     * Requests termination of all threads of the pool. Pool accepts no jobs afterwards.
+     *
+     * @param processScheduledJobs controls is we shall wait until all scheduled jobs processed,
+     * or terminate once jobs being executed are done, cancelling the rest.
+     */
+    public fun requestTermination(processScheduledJobs: Boolean = true) =
+            Future<Unit>(requestPoolTerminationInternal(id, processScheduledJobs))
+
+    /**
+     * Plan job for further execution by some thread of the pool, see [Worker.execute] for details
+     * on how [producer] result is transferred and what [job] may capture.
+     *
+     * @return the future with the computation result of [job]
+     */
+    @Suppress("UNUSED_PARAMETER")
+    @TypedIntrinsic(IntrinsicType.WORKER_EXECUTE)
+    public fun <T1, T2> execute(mode: TransferMode, producer: () -> T1, @VolatileLambda job: (T1) -> T2): Future<T2> =
+            /*
+             * This function is a magical operation, handled by lowering in the compiler, and replaced with call to
+             *   executeImpl(pool.id, mode, producer, job)
+             * but first ensuring that `job` parameter  doesn't capture any state.
+             */
+            throw RuntimeException("Shall not be called directly")
+
+    /**
+     * Plan batch of [count] jobs for further execution in the pool, which is cheaper than [execute] called
+     * [count] times, as the whole batch is transferred, queued and completed at once. Batch is executed by
+     * a single thread of the pool, so split work into several batches to keep all threads busy.
+     * [producer] is called with index of each job in the batch, and all produced objects together must form
+     * an isolated object subgraph, if in checked mode. Then [job] is called with each of them in the order of
+     * indices, and the results are transferred back together once all jobs of the batch are done.
+     * If any job throws, the rest of the batch is not executed, and the group is in [FutureState.THROWN] state.
+     * Same as for [execute], [job] must not capture any state.
+     *
+     * @return the future group with the results of all jobs in the batch
+     */
+    @Suppress("UNUSED_PARAMETER")
+    @TypedIntrinsic(IntrinsicType.WORKER_EXECUTE_BATCH)
+    public fun <T1, T2> executeBatch(mode: TransferMode, count: Int, producer: (Int) -> T1,
+                                     @VolatileLambda job: (T1) -> T2): FutureGroup<T2> =
+            /*
+             * This function is a magical operation, handled by lowering in the compiler, and replaced with call to
+             *   executeBatchImpl(pool.id, mode, count, producer, job)
+             * but first ensuring that `job` parameter  doesn't capture any state.
+             */
+            throw RuntimeException("Shall not be called directly")
+
+    override public fun toString(): String = "worker pool $id"
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright 2010-2018 JetBrains s.r.o. Use of this source code is governed by the Apache 2.0 license
+ * that can be found in the LICENSE file.
+ */
+
+package kotlin.native.internal
+
+/**
+ * Sampling allocation profiler.
+ *
+ * Once per [samplingInterval] allocated bytes on average, an allocation is recorded along with its type
+ * and stack trace. Samples of all threads are aggregated into heap profile in pprof format.
+ * Profiler could also be enabled at startup by setting `KONAN_ALLOCATION_PROFILE` environment variable
+ * to the file name, where profile is written at exit. `KONAN_ALLOCATION_SAMPLING_INTERVAL` variable
+ * overrides default sampling interval of 512 KiB in that case.
+ */
+object AllocationProfiler {
+    /**
+     * Average number of bytes allocated between samples. Zero (default) disables profiler.
+     */
+    var samplingInterval: Long
+        get() = getSamplingInterval()
+        set(value) = setSamplingInterval(value)
+
+    /**
+     * Returns allocations sampled so far as pprof profile (`profile.proto` message), to be written
+     * to a file and analyzed with `pprof`.
+     */
+    @SymbolName("Kotlin_native_internal_AllocationProfiler_dump")
+    external fun dump(): ByteArray
+
+    /**
+     * Forgets allocations sampled so far.
+     */
+    @SymbolName("Kotlin_native_internal_AllocationProfiler_reset")
+    external fun reset()
+
+    @SymbolName("Kotlin_native_internal_AllocationProfiler_getSamplingInterval")
+    private external fun getSamplingInterval(): Long
+
+    @SymbolName("Kotlin_native_internal_AllocationProfiler_setSamplingInterval")
+    private external fun setSamplingInterval(value: Long)
+}
@@ -68,4 +68,77 @@ object GC {
 
     @SymbolName("Kotlin_native_internal_GC_setThreshold")
     private external fun setThreshold(value: Int)
+
+    /**
+     * Maximal pause of automatically triggered garbage collection, in microseconds.
+     * If non-zero, cycle collection is performed incrementally: once time budget is exceeded,
+     * remaining release candidates are processed by the next collections. Zero (default) means
+     * collection always processes all candidates. Explicit [collect] is never bounded.
+     */
+    var maxPauseMicros: Long
+        get() = getMaxPauseMicros()
+        set(value) = setMaxPauseMicros(value)
+
+    @SymbolName("Kotlin_native_internal_GC_getMaxPauseMicros")
+    private external fun getMaxPauseMicros(): Long
+
+    @SymbolName("Kotlin_native_internal_GC_setMaxPauseMicros")
+    private external fun setMaxPauseMicros(value: Long)
+
+    /**
+     * If GC adjusts [threshold] automatically, based on time spent in collection, recent pauses
+     * and heap growth. Automatic adjustments decay back to the value set explicitly to [threshold].
+     * Enabled by default.
+     */
+    var autotune: Boolean
+        get() = getAutotune()
+        set(value) = setAutotune(value)
+
+    @SymbolName("Kotlin_native_internal_GC_getAutotune")
+    private external fun getAutotune(): Boolean
+
+    @SymbolName("Kotlin_native_internal_GC_setAutotune")
+    private external fun setAutotune(value: Boolean)
+
+    /**
+     * Desired collection pause, in microseconds. If non-zero and [autotune] is enabled, [threshold]
+     * is decreased while average pause exceeds this value. Zero (default) means no target pause.
+     */
+    var targetPauseMicros: Long
+        get() = getTargetPauseMicros()
+        set(value) = setTargetPauseMicros(value)
+
+    @SymbolName("Kotlin_native_internal_GC_getTargetPauseMicros")
+    private external fun getTargetPauseMicros(): Long
+
+    @SymbolName("Kotlin_native_internal_GC_setTargetPauseMicros")
+    private external fun setTargetPauseMicros(value: Long)
+
+    /**
+     * Number of bytes allocated since last collection, which triggers collection even if there are
+     * less release candidates than [threshold]. Useful for memory-constrained applications.
+     * Zero (default) means allocations do not trigger collection.
+     */
+    var allocationThreshold: Long
+        get() = getAllocationThreshold()
+        set(value) = setAllocationThreshold(value)
+
+    @SymbolName("Kotlin_native_internal_GC_getAllocationThreshold")
+    private external fun getAllocationThreshold(): Long
+
+    @SymbolName("Kotlin_native_internal_GC_setAllocationThreshold")
+    private external fun setAllocationThreshold(value: Long)
+
+    /**
+     * Returns memory manager counters of the current thread. Counters are always collected
+     * and are cheap to obtain, so could be watched in production.
+     */
+    fun statistics(): MemoryStatistics {
+        val counters = LongArray(MemoryStatistics.SIZE)
+        getStatistics(counters)
+        return MemoryStatistics(counters)
+    }
+
+    @SymbolName("Kotlin_native_internal_GC_getStatistics")
+    private external fun getStatistics(counters: LongArray)
 }
\ No newline at end of file
@@ -0,0 +1,29 @@
+/*
+ * Copyright 2010-2018 JetBrains s.r.o. Use of this source code is governed by the Apache 2.0 license
+ * that can be found in the LICENSE file.
+ */
+
+package kotlin.native.internal
+
+/**
+ * Heap snapshot of the current thread.
+ *
+ * Snapshot contains all live objects allocated by the current thread, or transferred to it in
+ * [kotlin.native.concurrent.TransferMode.ARENA] mode, their types with reference field names, references
+ * between objects, reference counts and objects referenced from the stack.
+ * Snapshot is to be written to a file and analyzed with `tools/scripts/heap_snapshot_analyzer.py`,
+ * which computes retained sizes and shows what keeps objects alive.
+ * Cyclic garbage not yet collected is included, so consider calling [GC.collect] before taking snapshot,
+ * or compare snapshots taken with and without collection to find garbage cycles.
+ */
+object HeapSnapshot {
+    /**
+     * Returns heap snapshot of the current thread.
+     * Note that taking snapshot frees memory as a side effect: objects no longer referenced from the stack
+     * are released once stack references are accounted, and memory of released objects waiting in the
+     * finalizer queue is freed, so that they are not reported. Cyclic garbage is not collected.
+     * Throws [IllegalStateException] if runtime doesn't track live objects in this configuration.
+     */
+    @SymbolName("Kotlin_native_internal_HeapSnapshot_dump")
+    external fun dump(): ByteArray
+}
@@ -74,5 +74,6 @@ class IntrinsicType {
 
         // Worker
         const val WORKER_EXECUTE                = "WORKER_EXECUTE"
+        const val WORKER_EXECUTE_BATCH          = "WORKER_EXECUTE_BATCH"
     }
 }
\ No newline at end of file
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2010-2018 JetBrains s.r.o. Use of this source code is governed by the Apache 2.0 license
+ * that can be found in the LICENSE file.
+ */
+
+package kotlin.native.internal
+
+/**
+ * Memory manager counters of the current thread, since its start, as returned by [GC.statistics].
+ */
+class MemoryStatistics internal constructor(private val counters: LongArray) {
+    /** Bytes allocated in containers. */
+    val allocatedBytes: Long get() = counters[0]
+    /** Number of containers released to the allocator. */
+    val freedContainers: Long get() = counters[1]
+    /** Number of regular reference count increments. */
+    val addRefs: Long get() = counters[2]
+    /** Number of atomic reference count increments, done on shared objects. */
+    val atomicAddRefs: Long get() = counters[3]
+    /** Number of regular reference count decrements. */
+    val releaseRefs: Long get() = counters[4]
+    /** Number of atomic reference count decrements, done on shared objects. */
+    val atomicReleaseRefs: Long get() = counters[5]
+    /** Number of cycle collections. */
+    val gcRuns: Long get() = counters[6]
+    /** Total time spent in cycle collections, in microseconds. */
+    val gcPauseMicros: Long get() = counters[7]
+    /** Longest cycle collection, in microseconds. */
+    val gcMaxPauseMicros: Long get() = counters[8]
+    /** Maximal number of cycle collector release candidates. */
+    val maxReleaseCandidates: Long get() = counters[9]
+
+    /**
+     * Number of allocated containers by size class. Element `i` counts containers of up to `16 shl i` bytes,
+     * except the last one, counting all larger containers.
+     */
+    val allocations: LongArray get() = counters.copyOfRange(FIRST_SIZE_CLASS, counters.size)
+
+    /** Total number of allocated containers. */
+    val allocatedContainers: Long get() {
+        var result = 0L
+        for (index in FIRST_SIZE_CLASS until counters.size) result += counters[index]
+        return result
+    }
+
+    /**
+     * Returns counters as JSON object.
+     */
+    fun toJson(): String = with(StringBuilder()) {
+        append("{")
+        append("\"allocatedBytes\":").append(allocatedBytes)
+        append(",\"allocatedContainers\":").append(allocatedContainers)
+        append(",\"freedContainers\":").append(freedContainers)
+        append(",\"addRefs\":").append(addRefs)
+        append(",\"atomicAddRefs\":").append(atomicAddRefs)
+        append(",\"releaseRefs\":").append(releaseRefs)
+        append(",\"atomicReleaseRefs\":").append(atomicReleaseRefs)
+        append(",\"gcRuns\":").append(gcRuns)
+        append(",\"gcPauseMicros\":").append(gcPauseMicros)
+        append(",\"gcMaxPauseMicros\":").append(gcMaxPauseMicros)
+        append(",\"maxReleaseCandidates\":").append(maxReleaseCandidates)
+        append(",\"allocations\":[")
+        allocations.forEachIndexed { index, count ->
+            if (index > 0) append(",")
+            append(count)
+        }
+        append("]}")
+        toString()
+    }
+
+    override fun toString() = toJson()
+
+    internal companion object {
+        // Must match MemoryCounters in Memory.cpp.
+        const val FIRST_SIZE_CLASS = 10
+        const val SIZE_CLASSES = 10
+        const val SIZE = FIRST_SIZE_CLASS + SIZE_CLASSES
+    }
+}
@@ -0,0 +1,326 @@
+#!/usr/bin/env python3
+#
+# Copyright 2010-2018 JetBrains s.r.o.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+"""
+Analyzer of heap snapshots produced by kotlin.native.internal.HeapSnapshot.dump().
+
+Usage:
+  heap_snapshot_analyzer.py snapshot.bin              summary, biggest types and objects by retained size
+  heap_snapshot_analyzer.py snapshot.bin --paths 5    also shows how the biggest objects are reached
+  heap_snapshot_analyzer.py old.bin new.bin           types which grew between two snapshots
+
+Objects are reachable from stack roots and from containers having more references than there are
+references from other containers of the snapshot, i.e. referenced from globals, other threads or native code.
+Objects not reachable from such roots are garbage not yet collected: zero reference count objects pending
+release, or cycles waiting for the cycle collector.
+"""
+
+import argparse
+import collections
+import sys
+
+TYPE_RECORD = 1
+CONTAINER_RECORD = 2
+OBJECT_RECORD = 3
+STACK_ROOT_RECORD = 4
+
+OBJECT_TYPE = 0
+REFERENCE_ARRAY_TYPE = 1
+PRIMITIVE_ARRAY_TYPE = 2
+
+FROZEN_CONTAINER = 1
+
+Type = collections.namedtuple('Type', ['name', 'kind', 'fields'])
+Container = collections.namedtuple('Container', ['ref_count', 'flags'])
+Object = collections.namedtuple('Object', ['type', 'container', 'size', 'refs'])
+
+
+class Snapshot(object):
+    def __init__(self, data):
+        self.data = data
+        self.position = 0
+        self.types = {}
+        self.containers = {}
+        self.objects = {}
+        self.stack_roots = []
+        self.parse()
+
+    def varint(self):
+        result = 0
+        shift = 0
+        while True:
+            byte = self.data[self.position]
+            self.position += 1
+            result |= (byte & 0x7f) << shift
+            shift += 7
+            if byte < 0x80:
+                return result
+
+    def string(self):
+        size = self.varint()
+        result = self.data[self.position:self.position + size].decode('utf-8', 'replace')
+        self.position += size
+        return result
+
+    def parse(self):
+        if self.data[:4] != b'KNHS':
+            raise ValueError('not a heap snapshot')
+        self.position = 4
+        version = self.varint()
+        if version != 1:
+            raise ValueError('unsupported snapshot version %d' % version)
+        while self.position < len(self.data):
+            kind = self.varint()
+            if kind == TYPE_RECORD:
+                type_id = self.varint()
+                name = self.string()
+                type_kind = self.varint()
+                fields = [self.string() for _ in range(self.varint())]
+                self.types[type_id] = Type(name, type_kind, fields)
+            elif kind == CONTAINER_RECORD:
+                container_id = self.varint()
+                self.containers[container_id] = Container(self.varint(), self.varint())
+            elif kind == OBJECT_RECORD:
+                object_id = self.varint()
+                type_id = self.varint()
+                container_id = self.varint()
+                size = self.varint()
+                refs = []
+                for _ in range(self.varint()):
+                    slot = self.varint()
+                    refs.append((slot, self.varint()))
+                self.objects[object_id] = Object(type_id, container_id, size, refs)
+            elif kind == STACK_ROOT_RECORD:
+                self.stack_roots.append(self.varint())
+            else:
+                raise ValueError('unknown record %d at %d' % (kind, self.position))
+
+    def type_name(self, object_id):
+        return self.types[self.objects[object_id].type].name
+
+    def slot_name(self, object_id, slot):
+        type_info = self.types[self.objects[object_id].type]
+        if type_info.kind == OBJECT_TYPE and slot < len(type_info.fields) and type_info.fields[slot]:
+            return '.' + type_info.fields[slot]
+        if type_info.kind == REFERENCE_ARRAY_TYPE:
+            return '[%d]' % slot
+        return '.<field %d>' % slot
+
+    def roots(self):
+        """Returns objects referenced from the stack or from outside of the snapshot."""
+        incoming = collections.Counter()
+        for obj in self.objects.values():
+            for _, target_id in obj.refs:
+                target = self.objects.get(target_id)
+                if target is not None and target.container != obj.container:
+                    incoming[target.container] += 1
+        external = set(container_id for container_id, container in self.containers.items()
+                       if container.ref_count > incoming[container_id])
+        result = [object_id for object_id in self.stack_roots if object_id in self.objects]
+        result.extend(object_id for object_id, obj in self.objects.items() if obj.container in external)
+        return list(collections.OrderedDict.fromkeys(result))
+
+
+class Analysis(object):
+    """Dominator tree of objects reachable from roots, and retained sizes."""
+
+    ROOT = 0
+
+    def __init__(self, snapshot):
+        self.snapshot = snapshot
+        self.roots = snapshot.roots()
+        successors = {self.ROOT: self.roots}
+        for object_id, obj in snapshot.objects.items():
+            successors[object_id] = [target for _, target in obj.refs if target in snapshot.objects]
+        self.order = self.reverse_postorder(successors)
+        self.index = {node: index for index, node in enumerate(self.order)}
+        predecessors = collections.defaultdict(list)
+        for node in self.order:
+            for target in successors[node]:
+                predecessors[target].append(node)
+        self.dominators = self.compute_dominators(predecessors)
+        self.parent = self.shortest_paths(successors)
+        self.retained = {}
+        for node in reversed(self.order):
+            self.retained[node] = self.retained.get(node, 0) + (snapshot.objects[node].size if node != self.ROOT else 0)
+            if node != self.ROOT:
+                dominator = self.dominators[node]
+                self.retained[dominator] = self.retained.get(dominator, 0) + self.retained[node]
+
+    def reverse_postorder(self, successors):
+        visited = {self.ROOT}
+        postorder = []
+        stack = [(self.ROOT, iter(successors[self.ROOT]))]
+        while stack:
+            node, children = stack[-1]
+            for child in children:
+                if child not in visited:
+                    visited.add(child)
+                    stack.append((child, iter(successors[child])))
+                    break
+            else:
+                stack.pop()
+                postorder.append(node)
+        postorder.reverse()
+        return postorder
+
+    # Cooper, Harvey, Kennedy: "A Simple, Fast Dominance Algorithm".
+    def compute_dominators(self, predecessors):
+        index = self.index
+        dominators = {self.ROOT: self.ROOT}
+
+        def intersect(first, second):
+            while first != second:
+                while index[first] > index[second]:
+                    first = dominators[first]
+                while index[second] > index[first]:
+                    second = dominators[second]
+            return first
+
+        changed = True
+        while changed:
+            changed = False
+            for node in self.order[1:]:
+                new_dominator = None
+                for predecessor in predecessors[node]:
+                    if predecessor not in dominators:
+                        continue
+                    new_dominator = predecessor if new_dominator is None else intersect(predecessor, new_dominator)
+                if dominators.get(node) != new_dominator:
+                    dominators[node] = new_dominator
+                    changed = True
+        return dominators
+
+    def shortest_paths(self, successors):
+        parent = {self.ROOT: None}
+        queue = collections.deque([self.ROOT])
+        while queue:
+            node = queue.popleft()
+            for target in successors[node]:
+                if target not in parent:
+                    parent[target] = node
+                    queue.append(target)
+        return parent
+
+    def path(self, object_id):
+        snapshot = self.snapshot
+        steps = []
+        node = object_id
+        while self.parent[node] != self.ROOT:
+            source = self.parent[node]
+            slot = next(slot for slot, target in snapshot.objects[source].refs if target == node)
+            steps.append((source, slot))
+            node = source
+        kind = 'stack' if node in snapshot.stack_roots else 'external'
+        result = '<%s> %s@%x' % (kind, snapshot.type_name(node), node)
+        for source, slot in reversed(steps):
+            result += snapshot.slot_name(source, slot)
+        return result
+
+    def unreachable(self):
+        return [object_id for object_id in self.snapshot.objects if object_id not in self.index]
+
+
+def type_histogram(snapshot, objects=None):
+    histogram = collections.defaultdict(lambda: [0, 0])
+    for object_id in (snapshot.objects if objects is None else objects):
+        obj = snapshot.objects[object_id]
+        entry = histogram[snapshot.types[obj.type].name]
+        entry[0] += 1
+        entry[1] += obj.size
+    return histogram
+
+
+def load(path):
+    with open(path, 'rb') as file:
+        return Snapshot(bytearray(file.read()))
+
+
+def report(snapshot, top, paths):
+    analysis = Analysis(snapshot)
+    total = sum(obj.size for obj in snapshot.objects.values())
+    frozen = sum(1 for container in snapshot.containers.values() if container.flags & FROZEN_CONTAINER)
+    print('Objects: %d, %d bytes, containers: %d (%d frozen), roots: %d (%d from stack)' % (
+        len(snapshot.objects), total, len(snapshot.containers), frozen, len(analysis.roots), len(snapshot.stack_roots)))
+
+    retained_by_type = collections.defaultdict(int)
+    for object_id in analysis.order[1:]:
+        dominator = analysis.dominators[object_id]
+        name = snapshot.type_name(object_id)
+        # Count objects dominated by an object of the same type only once.
+        if dominator == Analysis.ROOT or snapshot.type_name(dominator) != name:
+            retained_by_type[name] += analysis.retained[object_id]
+    histogram = type_histogram(snapshot)
+    print('\nTypes by retained size:')
+    print('%12s %12s %12s  %s' % ('retained', 'shallow', 'count', 'type'))
+    for name in sorted(histogram, key=lambda name: -retained_by_type[name])[:top]:
+        count, size = histogram[name]
+        print('%12d %12d %12d  %s' % (retained_by_type[name], size, count, name))
+
+    biggest = sorted(analysis.order[1:], key=lambda object_id: -analysis.retained[object_id])[:top]
+    print('\nObjects by retained size:')
+    for object_id in biggest:
+        print('%12d  %s@%x' % (analysis.retained[object_id], snapshot.type_name(object_id), object_id))
+
+    if paths > 0:
+        print('\nShortest paths from roots:')
+        for object_id in biggest[:paths]:
+            print('  ' + analysis.path(object_id))
+
+    unreachable = analysis.unreachable()
+    if unreachable:
+        garbage = type_histogram(snapshot, unreachable)
+        print('\nUnreachable objects (garbage not yet collected): %d, %d bytes' % (
+            len(unreachable), sum(size for _, size in garbage.values())))
+        for name in sorted(garbage, key=lambda name: -garbage[name][1])[:top]:
+            count, size = garbage[name]
+            print('%12d %12d  %s' % (size, count, name))
+
+
+def diff(old, new, top):
+    old_histogram = type_histogram(old)
+    new_histogram = type_histogram(new)
+    changes = []
+    for name, (count, size) in new_histogram.items():
+        old_count, old_size = old_histogram.get(name, (0, 0))
+        if count != old_count or size != old_size:
+            changes.append((size - old_size, count - old_count, name))
+    for name, (old_count, old_size) in old_histogram.items():
+        if name not in new_histogram:
+            changes.append((-old_size, -old_count, name))
+    changes.sort(reverse=True)
+    print('%12s %12s  %s' % ('bytes', 'count', 'type'))
+    for size, count, name in changes[:top]:
+        print('%+12d %+12d  %s' % (size, count, name))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Analyzes Kotlin/Native heap snapshots.')
+    parser.add_argument('snapshot', help='heap snapshot file')
+    parser.add_argument('newer', nargs='?', help='newer snapshot to compare with')
+    parser.add_argument('--top', type=int, default=20, help='number of types and objects to show')
+    parser.add_argument('--paths', type=int, default=0, help='show paths from roots to that many biggest objects')
+    args = parser.parse_args()
+    if args.newer is not None:
+        diff(load(args.snapshot), load(args.newer), args.top)
+    else:
+        report(load(args.snapshot), args.top, args.paths)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())